@@ -1,4 +1,5 @@
 #!/bin/sh
 ./make_clean.sh
 ./make_build.sh
+(cd build && ctest --output-on-failure)    # unit tests of src/lib
 python3 -m pytest test --debug_test     # add -vv for verbose output
\ No newline at end of file
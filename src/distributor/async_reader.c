@@ -0,0 +1,258 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "./async_reader.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// the part of a request a single read covers
+typedef struct{
+    size_t request;
+    size_t start;           // within the request
+    size_t len;
+}read_piece;
+
+// reads the rest of the request with pread
+static void read_with_pread(read_request *request){
+    while(request->done < request->len){
+        ssize_t bytes = pread(request->fd, &request->buffer[request->done], request->len - request->done,
+            request->offset + (off_t) request->done);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes <= 0){
+            if(bytes < 0)
+                fprintf(stderr, "Could not read from input file.\n");
+            return;
+        }
+        request->done += (size_t) bytes;
+    }
+}
+
+#ifdef HAVE_IO_URING
+
+struct async_reader{
+    int fd;
+    _Atomic unsigned *sq_head;
+    _Atomic unsigned *sq_tail;
+    unsigned sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    _Atomic unsigned *cq_head;
+    _Atomic unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring;              // same as sq_ring with IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+    bool broken;                // io_uring_enter failed, the queues can't be trusted anymore
+};
+
+async_reader* async_reader_init(void){
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int) syscall(__NR_io_uring_setup, ASYNC_READ_DEPTH, &params);
+    if(fd < 0)
+        return NULL;
+
+    async_reader *reader = (async_reader *) calloc(1, sizeof(async_reader));
+    if(!reader){
+        fprintf(stderr, "Could not allocate async reader.\n");
+        exit(1);
+    }
+    reader->fd = fd;
+    reader->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    reader->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP){
+        if(reader->cq_ring_size > reader->sq_ring_size)
+            reader->sq_ring_size = reader->cq_ring_size;
+        reader->cq_ring_size = reader->sq_ring_size;
+    }
+
+    reader->sq_ring = mmap(NULL, reader->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    reader->cq_ring = reader->sq_ring;
+    if(reader->sq_ring != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+        reader->cq_ring = mmap(NULL, reader->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    reader->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    reader->sqes = (struct io_uring_sqe *) mmap(NULL, reader->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(reader->sq_ring == MAP_FAILED || reader->cq_ring == MAP_FAILED || reader->sqes == MAP_FAILED){
+        if(reader->sqes != MAP_FAILED)
+            munmap(reader->sqes, reader->sqes_size);
+        if(reader->cq_ring != MAP_FAILED && reader->cq_ring != reader->sq_ring)
+            munmap(reader->cq_ring, reader->cq_ring_size);
+        if(reader->sq_ring != MAP_FAILED)
+            munmap(reader->sq_ring, reader->sq_ring_size);
+        close(fd);
+        free(reader);
+        return NULL;
+    }
+
+    char *sq = (char *) reader->sq_ring;
+    char *cq = (char *) reader->cq_ring;
+    reader->sq_head = (_Atomic unsigned *) (sq + params.sq_off.head);
+    reader->sq_tail = (_Atomic unsigned *) (sq + params.sq_off.tail);
+    reader->sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+    reader->sq_array = (unsigned *) (sq + params.sq_off.array);
+    reader->cq_head = (_Atomic unsigned *) (cq + params.cq_off.head);
+    reader->cq_tail = (_Atomic unsigned *) (cq + params.cq_off.tail);
+    reader->cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+    reader->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    return reader;
+}
+
+// puts a read of the piece into the submission queue, it's submitted with the next io_uring_enter
+static void queue_piece(async_reader *reader, read_request *request, read_piece *piece, size_t piece_nr){
+    unsigned tail = atomic_load_explicit(reader->sq_tail, memory_order_relaxed);
+    unsigned index = tail & reader->sq_mask;
+    struct io_uring_sqe *sqe = &reader->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = request->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &request->buffer[piece->start];
+    sqe->len = (unsigned) piece->len;
+    sqe->off = (uint64_t) request->offset + piece->start;
+    sqe->user_data = piece_nr;
+    reader->sq_array[index] = index;
+    atomic_store_explicit(reader->sq_tail, tail + 1, memory_order_release);
+}
+
+void read_requests(async_reader *reader, read_request requests[], size_t amount){
+    assert(requests);
+    if(!reader || reader->broken){
+        for(size_t i=0; i<amount; i++)
+            read_with_pread(&requests[i]);
+        return;
+    }
+
+    // every piece is read on its own, pieces that come back short are queued again with the rest of their bytes
+    size_t amount_of_pieces = 0;
+    for(size_t i=0; i<amount; i++)
+        amount_of_pieces += (requests[i].len + ASYNC_READ_LEN - 1) / ASYNC_READ_LEN;
+    read_piece *pieces = (read_piece *) calloc(amount_of_pieces + 1, sizeof(read_piece));
+    if(!pieces){
+        fprintf(stderr, "Could not allocate async reader.\n");
+        exit(1);
+    }
+    size_t nr = 0;
+    for(size_t i=0; i<amount; i++){
+        requests[i].done = 0;
+        for(size_t start=0; start<requests[i].len; start+=ASYNC_READ_LEN){
+            pieces[nr].request = i;
+            pieces[nr].start = start;
+            pieces[nr].len = requests[i].len - start < ASYNC_READ_LEN ? requests[i].len - start : ASYNC_READ_LEN;
+            nr++;
+        }
+    }
+
+    size_t next_piece = 0;
+    unsigned in_flight = 0;
+    unsigned to_submit = 0;
+    bool failed = false;        // io_uring_enter itself doesn't work -> the rest is read with pread
+    while(!failed && (next_piece < amount_of_pieces || in_flight > 0)){
+        while(next_piece < amount_of_pieces && in_flight < ASYNC_READ_DEPTH){
+            queue_piece(reader, &requests[pieces[next_piece].request], &pieces[next_piece], next_piece);
+            next_piece++;
+            in_flight++;
+            to_submit++;
+        }
+
+        int submitted = (int) syscall(__NR_io_uring_enter, reader->fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(submitted < 0){
+            if(errno == EINTR)
+                continue;
+            failed = true;
+            break;
+        }
+        to_submit -= (unsigned) submitted;
+
+        unsigned head = atomic_load_explicit(reader->cq_head, memory_order_relaxed);
+        unsigned tail = atomic_load_explicit(reader->cq_tail, memory_order_acquire);
+        for(; head != tail; head++){
+            struct io_uring_cqe *cqe = &reader->cqes[head & reader->cq_mask];
+            read_piece *piece = &pieces[cqe->user_data];
+            read_request *request = &requests[piece->request];
+            in_flight--;
+
+            if(cqe->res == -EINTR || cqe->res == -EAGAIN){
+                queue_piece(reader, request, piece, (size_t) cqe->user_data);
+                in_flight++;
+                to_submit++;
+                continue;
+            }
+            if(cqe->res < 0){
+                // e.g. a kernel without IORING_OP_READ, pread tells if the file can't be read at all
+                read_request rest = {request->fd, &request->buffer[piece->start], piece->len, request->offset + (off_t) piece->start, 0};
+                read_with_pread(&rest);
+                request->done += rest.done;
+                continue;
+            }
+            // 0 -> the file ended early (it shrank since it was listed)
+            request->done += (size_t) cqe->res;
+            if(cqe->res > 0 && (size_t) cqe->res < piece->len){
+                piece->start += (size_t) cqe->res;
+                piece->len -= (size_t) cqe->res;
+                queue_piece(reader, request, piece, (size_t) cqe->user_data);
+                in_flight++;
+                to_submit++;
+            }
+        }
+        atomic_store_explicit(reader->cq_head, head, memory_order_release);
+    }
+    free(pieces);
+
+    // start over with pread, the buffers are overwritten with the same bytes
+    if(failed){
+        reader->broken = true;
+        for(size_t i=0; i<amount; i++){
+            requests[i].done = 0;
+            read_with_pread(&requests[i]);
+        }
+    }
+}
+
+void async_reader_destroy(async_reader *reader){
+    if(!reader)
+        return;
+    munmap(reader->sqes, reader->sqes_size);
+    if(reader->cq_ring != reader->sq_ring)
+        munmap(reader->cq_ring, reader->cq_ring_size);
+    munmap(reader->sq_ring, reader->sq_ring_size);
+    close(reader->fd);
+    free(reader);
+}
+
+#else
+
+struct async_reader{
+    int unused;
+};
+
+async_reader* async_reader_init(void){
+    return NULL;
+}
+
+void read_requests(async_reader *reader, read_request requests[], size_t amount){
+    assert(requests);
+    (void) reader;
+    for(size_t i=0; i<amount; i++)
+        read_with_pread(&requests[i]);
+}
+
+void async_reader_destroy(async_reader *reader){
+    (void) reader;
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+// This header houses the asynchronous reader of the input files (io_uring, without liburing)
+// a batch of reads is split into pieces, which are all in flight at once, so the disk is busy while the chunker cuts
+// if io_uring isn't available (old kernel, seccomp), async_reader_init returns NULL and read_requests falls back to pread
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+// reads are split into pieces of this size
+#define ASYNC_READ_LEN (1 << 20)
+// pieces in flight per reader
+#define ASYNC_READ_DEPTH 32
+
+typedef struct async_reader async_reader;
+
+typedef struct{
+    int fd;
+    char *buffer;
+    size_t len;
+    off_t offset;
+    size_t done;            // bytes read, less than len if the file ended before (or couldn't be read)
+}read_request;
+
+// returns NULL if io_uring can't be used
+async_reader* async_reader_init(void);
+// reads all requests and waits until they are done, reader may be NULL (then every request is read with pread)
+void read_requests(async_reader *reader, read_request requests[], size_t amount);
+void async_reader_destroy(async_reader *reader);
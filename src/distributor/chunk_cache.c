@@ -0,0 +1,459 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "./chunk_cache.h"
+
+// once the cache is too big, segments are evicted until it's back at this fraction of its size (so it doesn't evict on every put)
+#define EVICT_TO 0.9
+// amount of buckets of the index
+#define INDEX_BUCKETS (1 << 16)
+// index records that are buffered at most (a flush writes them along with the results)
+#define PENDING_RECORDS 4096
+// the mtime of a segment that has been read from is set at most this often (s), it's only the order that matters
+#define TOUCH_INTERVAL 60
+
+// where the result of a key is
+typedef struct{
+    uint32_t segment;
+    uint32_t offset;
+    uint32_t len;
+}cache_entry;
+
+static size_t hash_key(const void *key){
+    return (size_t) ((const chunk_key *) key)->low;
+}
+
+static bool compare_keys(const void *key1, const void *key2){
+    return !memcmp(key1, key2, sizeof(chunk_key));
+}
+
+static inline uint64_t rotate_left(uint64_t x, int bits){
+    return (x << bits) | (x >> (64 - bits));
+}
+
+// finalizer of murmur3, every input bit affects every output bit
+static inline uint64_t mix(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// two independent lanes over 8 bytes at a time, this is way faster than the round trip it saves
+chunk_key chunk_cache_key(const char *chunk, size_t len, MSG_TYPE command){
+    uint64_t first = 0x9e3779b97f4a7c15ULL ^ (uint64_t) command;
+    uint64_t second = 0xc2b2ae3d27d4eb4fULL + (uint64_t) len;
+
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8){
+        uint64_t word;
+        memcpy(&word, &chunk[i], 8);
+        first = rotate_left(first ^ (word * 0x87c37b91114253d5ULL), 31) * 0x4cf5ad432745937fULL;
+        second = rotate_left(second + (word ^ 0x52dce729ULL), 27) * 0x9e3779b97f4a7c15ULL + first;
+    }
+    uint64_t rest = 0;
+    memcpy(&rest, &chunk[i], len - i);
+    first ^= rest * 0x87c37b91114253d5ULL;
+    second += rest ^ (uint64_t) len;
+
+    chunk_key key = {mix(first + second), mix(second ^ rotate_left(first, 17))};
+    return key;
+}
+
+// <dir>/<name><extension>
+static void segment_path(chunk_cache *cache, const cache_segment *segment, const char *extension, char *path, size_t size){
+    snprintf(path, size, "%s/%s%s", cache->dir, segment->name, extension);
+}
+
+static double now_s(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// a small index still takes a whole block (or more), so the blocks are counted instead of the bytes
+static unsigned long long disk_size(const struct stat *info){
+    unsigned long long blocks = (unsigned long long) info->st_blocks * 512;
+    return blocks > (unsigned long long) info->st_size ? blocks : (unsigned long long) info->st_size;
+}
+
+static void make_dir(const char *path){
+    if(mkdir(path, 0755) != 0){
+        struct stat info;
+        if(stat(path, &info) != 0 || !S_ISDIR(info.st_mode)){
+            fprintf(stderr, "Could not create cache directory %s\n", path);
+            exit(1);
+        }
+    }
+}
+
+// returns false if the whole buffer couldn't be written
+static bool write_all(int fd, const void *data, size_t len){
+    const char *bytes = (const char *) data;
+    while(len > 0){
+        ssize_t written = write(fd, bytes, len);
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            return false;
+        bytes += written;
+        len -= (size_t) written;
+    }
+    return true;
+}
+
+static cache_segment* add_segment(chunk_cache *cache, const char *name){
+    if(cache->amount_of_segments == cache->capacity){
+        cache->capacity = cache->capacity ? cache->capacity * 2 : 16;
+        cache->segments = (cache_segment *) realloc(cache->segments, cache->capacity * sizeof(cache_segment));
+        if(!cache->segments){
+            fprintf(stderr, "Could not allocate cache segments.\n");
+            exit(1);
+        }
+    }
+    cache_segment *segment = &cache->segments[cache->amount_of_segments++];
+    memset(segment, 0, sizeof(cache_segment));
+    snprintf(segment->name, sizeof(segment->name), "%s", name);
+    segment->fd = -1;
+    segment->index_fd = -1;
+    return segment;
+}
+
+static void evict(chunk_cache *cache);
+
+// adds the segment of the index and the results it lists
+static void load_segment(chunk_cache *cache, const char *name){
+    cache_segment *segment = add_segment(cache, name);
+    char path[4096];
+    char index_path[4096];
+    segment_path(cache, segment, ".seg", path, sizeof(path));
+    segment_path(cache, segment, ".idx", index_path, sizeof(index_path));
+
+    struct stat info;
+    struct stat index_info;
+    FILE *index = fopen(index_path, "r");
+    if(!index || stat(path, &info) != 0 || fstat(fileno(index), &index_info) != 0){
+        // still being created by another run (or half evicted), it isn't counted
+        if(index)
+            fclose(index);
+        segment->gone = true;
+        return;
+    }
+    segment->len = (unsigned long long) info.st_size;
+    segment->disk_size = disk_size(&info) + disk_size(&index_info);
+    segment->last_used = info.st_mtim.tv_sec + info.st_mtim.tv_nsec / 1e9;
+    segment->touched = segment->last_used;
+    cache->size += segment->disk_size;
+
+    // the records of results that haven't made it into the segment (yet) are left out
+    uint32_t nr = (uint32_t)(cache->amount_of_segments - 1);
+    index_record records[256];
+    size_t amount;
+    while((amount = fread(records, sizeof(index_record), 256, index)) > 0){
+        for(size_t i=0; i<amount; i++){
+            if((unsigned long long) records[i].offset + records[i].len > segment->len)
+                continue;
+            chunk_key key = {records[i].high, records[i].low};
+            cache_entry entry = {nr, records[i].offset, records[i].len};
+            hashmap_put(cache->entries, &key, &entry);
+        }
+    }
+    fclose(index);
+}
+
+// reads the indices of earlier runs
+static void load_entries(chunk_cache *cache){
+    DIR *dir = opendir(cache->dir);
+    if(!dir)
+        return;
+
+    struct dirent *file;
+    while((file = readdir(dir))){
+        size_t len = strlen(file->d_name);
+        if(len <= 4 || len - 4 >= sizeof(((cache_segment *) NULL)->name) || strcmp(&file->d_name[len-4], ".idx") != 0)
+            continue;
+        char name[64] = {0};
+        memcpy(name, file->d_name, len - 4);
+        load_segment(cache, name);
+    }
+    closedir(dir);
+}
+
+chunk_cache* chunk_cache_open(const char *dir, unsigned long long max_size){
+    assert(dir);
+
+    chunk_cache *cache = (chunk_cache *) calloc(1, sizeof(chunk_cache));
+    if(!cache){
+        fprintf(stderr, "Could not allocate cache.\n");
+        exit(1);
+    }
+    cache->dir = strdup(dir);
+    cache->buffer = (char *) malloc(WRITE_BUFFER_LEN);
+    cache->pending = (index_record *) malloc(PENDING_RECORDS * sizeof(index_record));
+    if(!cache->dir || !cache->buffer || !cache->pending){
+        fprintf(stderr, "Could not allocate cache.\n");
+        exit(1);
+    }
+    cache->max_size = max_size;
+    cache->current = -1;
+    // segments are evicted as a whole, so there have to be a few of them
+    cache->segment_len = max_size / 8 < CACHE_SEGMENT_LEN ? max_size / 8 : CACHE_SEGMENT_LEN;
+    if(cache->segment_len < WRITE_BUFFER_LEN)
+        cache->segment_len = WRITE_BUFFER_LEN;
+    cache->entries = hashmap_init(INDEX_BUCKETS, sizeof(chunk_key), sizeof(cache_entry), hash_key, compare_keys);
+
+    make_dir(dir);
+    load_entries(cache);
+    // a smaller --cache-size than last time (or several runs that filled it at once) is enforced right away, not only
+    // once this run puts something
+    if(cache->size > cache->max_size)
+        evict(cache);
+    return cache;
+}
+
+// writes the buffered results to the current segment and their records to its index (in that order, so an index never
+// lists a result that isn't there)
+static void flush(chunk_cache *cache){
+    if(cache->amount_pending == 0)
+        return;
+
+    cache_segment *segment = &cache->segments[cache->current];
+    bool written = !segment->gone && write_all(segment->fd, cache->buffer, cache->buffered) &&
+                   write_all(segment->index_fd, cache->pending, cache->amount_pending * sizeof(index_record));
+    if(!written){
+        // the results are mapped again next time
+        if(!segment->gone)
+            fprintf(stderr, "Could not write to cache directory %s\n", cache->dir);
+        for(size_t i=0; i<cache->amount_pending; i++){
+            chunk_key key = {cache->pending[i].high, cache->pending[i].low};
+            hashmap_remove(cache->entries, &key);
+        }
+    }
+
+    // the blocks the files take now
+    struct stat info;
+    struct stat index_info;
+    if(!segment->gone && fstat(segment->fd, &info) == 0 && fstat(segment->index_fd, &index_info) == 0){
+        cache->size -= segment->disk_size;
+        segment->disk_size = disk_size(&info) + disk_size(&index_info);
+        cache->size += segment->disk_size;
+    }
+    cache->buffered = 0;
+    cache->amount_pending = 0;
+}
+
+// stops appending to the current segment
+static void finish_segment(chunk_cache *cache){
+    if(cache->current < 0)
+        return;
+    flush(cache);
+    cache_segment *segment = &cache->segments[cache->current];
+    if(segment->index_fd >= 0)
+        close(segment->index_fd);
+    segment->index_fd = -1;
+    cache->current = -1;
+}
+
+// creates a new segment for the results of this run, returns false if it can't be created
+static bool start_segment(chunk_cache *cache){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    char name[64];
+    snprintf(name, sizeof(name), "%016llx-%ld", (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec, (long) getpid());
+    cache_segment *segment = add_segment(cache, name);
+
+    // the index comes first, another run only reads segments that have one
+    char path[4096];
+    char index_path[4096];
+    segment_path(cache, segment, ".seg", path, sizeof(path));
+    segment_path(cache, segment, ".idx", index_path, sizeof(index_path));
+    segment->index_fd = open(index_path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if(segment->index_fd >= 0)
+        segment->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(segment->fd < 0){
+        fprintf(stderr, "Could not write to cache directory %s\n", cache->dir);
+        if(segment->index_fd >= 0){
+            close(segment->index_fd);
+            unlink(index_path);
+        }
+        cache->amount_of_segments--;
+        return false;
+    }
+    segment->last_used = now_s();
+    segment->touched = segment->last_used;
+    cache->current = (long)(cache->amount_of_segments - 1);
+    return true;
+}
+
+char* chunk_cache_get(chunk_cache *cache, chunk_key key, size_t chunk_len, size_t *len){
+    assert(cache);
+    assert(len);
+
+    cache_entry entry;
+    if(!hashmap_get(cache->entries, &key, &entry)){
+        cache->misses++;
+        return NULL;
+    }
+
+    cache_segment *segment = &cache->segments[entry.segment];
+    char *result = (char *) malloc(entry.len + 1);
+    if(!result){
+        fprintf(stderr, "Could not allocate cached result.\n");
+        exit(1);
+    }
+    unsigned long long written = segment->len - (cache->current == (long) entry.segment ? cache->buffered : 0);
+    if(entry.offset >= written)
+        memcpy(result, &cache->buffer[entry.offset - written], entry.len);       // still buffered
+    else{
+        if(segment->fd < 0){
+            char path[4096];
+            segment_path(cache, segment, ".seg", path, sizeof(path));
+            segment->fd = open(path, O_RDONLY);
+        }
+        if(segment->fd < 0 || pread(segment->fd, result, entry.len, entry.offset) != (ssize_t) entry.len){
+            // evicted by another run in the meantime (or broken) -> it's mapped again
+            free(result);
+            hashmap_remove(cache->entries, &key);
+            cache->misses++;
+            return NULL;
+        }
+    }
+
+    // the mtime of the segment keeps track of the last use across runs
+    segment->last_used = now_s();
+    if(segment->last_used - segment->touched >= TOUCH_INTERVAL && segment->fd >= 0){
+        futimens(segment->fd, NULL);
+        segment->touched = segment->last_used;
+    }
+
+    cache->hits++;
+    cache->hit_bytes += chunk_len;
+    *len = entry.len;
+    return result;
+}
+
+// helper for evict, collects the keys of the results in evicted segments
+typedef struct{
+    chunk_cache *cache;
+    chunk_key *keys;
+    size_t amount;
+    size_t capacity;
+}key_list;
+
+static void collect_gone(void *key, void *value, void *arg){
+    key_list *list = (key_list *) arg;
+    if(!list->cache->segments[((cache_entry *) value)->segment].gone)
+        return;
+    if(list->amount == list->capacity){
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->keys = (chunk_key *) realloc(list->keys, list->capacity * sizeof(chunk_key));
+        if(!list->keys){
+            fprintf(stderr, "Could not allocate cache entries.\n");
+            exit(1);
+        }
+    }
+    list->keys[list->amount++] = *(chunk_key *) key;
+}
+
+// removes the least recently used segments until the cache is back at EVICT_TO of its size (the current one stays)
+static void evict(chunk_cache *cache){
+    unsigned long long target = (unsigned long long)(cache->max_size * EVICT_TO);
+    bool evicted = false;
+    while(cache->size > target){
+        cache_segment *oldest = NULL;
+        for(size_t i=0; i<cache->amount_of_segments; i++){
+            cache_segment *segment = &cache->segments[i];
+            if(!segment->gone && (long) i != cache->current && (!oldest || segment->last_used < oldest->last_used))
+                oldest = segment;
+        }
+        if(!oldest)
+            break;
+
+        char path[4096];
+        segment_path(cache, oldest, ".idx", path, sizeof(path));
+        unlink(path);
+        segment_path(cache, oldest, ".seg", path, sizeof(path));
+        unlink(path);
+        if(oldest->fd >= 0)
+            close(oldest->fd);
+        oldest->fd = -1;
+        oldest->gone = true;
+        cache->size -= oldest->disk_size;
+        evicted = true;
+    }
+    if(!evicted)
+        return;
+
+    key_list list = {cache, NULL, 0, 0};
+    hashmap_for_each(cache->entries, collect_gone, &list);
+    for(size_t i=0; i<list.amount; i++)
+        hashmap_remove(cache->entries, &list.keys[i]);
+    cache->evictions += list.amount;
+    free(list.keys);
+}
+
+void chunk_cache_put(chunk_cache *cache, chunk_key key, const char *result, size_t len){
+    assert(cache);
+    assert(result || len == 0);
+
+    if(len > WRITE_BUFFER_LEN || hashmap_contains(cache->entries, &key))
+        return;
+
+    if(cache->current >= 0 && cache->segments[cache->current].len + len > cache->segment_len)
+        finish_segment(cache);
+    if(cache->current < 0 && !start_segment(cache))
+        return;
+    if(cache->buffered + len > WRITE_BUFFER_LEN || cache->amount_pending == PENDING_RECORDS)
+        flush(cache);
+
+    cache_segment *segment = &cache->segments[cache->current];
+    memcpy(&cache->buffer[cache->buffered], result, len);
+    cache->buffered += len;
+    cache->pending[cache->amount_pending++] = (index_record){key.high, key.low, (uint32_t) segment->len, (uint32_t) len};
+    cache_entry entry = {(uint32_t) cache->current, (uint32_t) segment->len, (uint32_t) len};
+    hashmap_put(cache->entries, &key, &entry);
+    segment->len += len;
+
+    // counted as bytes until the flush tells the blocks
+    segment->disk_size += len + sizeof(index_record);
+    cache->size += len + sizeof(index_record);
+    if(cache->size > cache->max_size)
+        evict(cache);
+}
+
+void chunk_cache_print_stats(chunk_cache *cache){
+    assert(cache);
+    unsigned long long lookups = cache->hits + cache->misses;
+    fprintf(stderr, "Chunk cache: %llu hits, %llu misses (%.1f%% hit rate), %llu bytes not mapped again, %llu evicted, %llu of %llu bytes used.\n",
+            cache->hits, cache->misses, lookups ? 100.0 * cache->hits / lookups : 0.0, cache->hit_bytes,
+            cache->evictions, cache->size, cache->max_size);
+}
+
+void chunk_cache_close(chunk_cache *cache){
+    assert(cache);
+    finish_segment(cache);
+    for(size_t i=0; i<cache->amount_of_segments; i++){
+        cache_segment *segment = &cache->segments[i];
+        if(segment->fd < 0)
+            continue;
+        if(segment->last_used > segment->touched)
+            futimens(segment->fd, NULL);
+        close(segment->fd);
+    }
+    hashmap_destroy(cache->entries);
+    free(cache->segments);
+    free(cache->buffer);
+    free(cache->pending);
+    free(cache->dir);
+    free(cache);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// This header houses the cache of MAP results (--cache <dir>)
+// every chunk is identified by a hash of its bytes, if a chunk has been mapped before (in this or an earlier run),
+// its result is read from the cache directory and the chunk isn't sent to a worker at all
+// the results are appended to segment files (<dir>/<name>.seg), every run writes its own segments, so several runs can
+// share the directory, next to every segment an index (<name>.idx) tells which results it holds (key, offset, length)
+// results are written in batches of WRITE_BUFFER_LEN bytes and read with a single pread, a result doesn't need a file
+// the cache is bounded by the disk space of the segments and their indices, the least recently used segments (by mtime)
+// are evicted as a whole, on open too if the cache has grown beyond it
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../lib/encoder.h"
+#include "../lib/hashmap.h"
+
+// 128 bit, a collision would silently mix up the counts of two chunks
+typedef struct{
+    uint64_t high;
+    uint64_t low;
+}chunk_key;
+
+// a segment holds at most this many bytes of results (or an eighth of the cache, if that's less)
+#define CACHE_SEGMENT_LEN (64 << 20)
+// results are written to the current segment once this many bytes of them have been put
+#define WRITE_BUFFER_LEN (1 << 20)
+
+// where a result is, the index of a segment holds these one after the other
+typedef struct{
+    uint64_t high;
+    uint64_t low;
+    uint32_t offset;
+    uint32_t len;
+}index_record;
+
+typedef struct{
+    char name[64];                      // file name without .seg/.idx
+    int fd;                             // -1 until it's read from (or written to)
+    int index_fd;                       // only while it's written to
+    unsigned long long len;             // bytes of results in it (written or buffered)
+    unsigned long long disk_size;       // blocks of the segment and its index
+    double last_used;                   // s since the epoch, the mtime of the segment (so it survives the run)
+    double touched;                     // when the mtime has been set to last_used
+    bool gone;                          // evicted
+}cache_segment;
+
+typedef struct{
+    char *dir;
+    hashmap *entries;                   // chunk_key -> segment, offset and length of the result
+    cache_segment *segments;
+    size_t amount_of_segments;
+    size_t capacity;
+    long current;                       // segment the results of this run are appended to (-1 before the first one)
+    unsigned long long segment_len;
+    char *buffer;                       // results that haven't been written to the current segment yet
+    size_t buffered;
+    index_record *pending;              // and their index records
+    size_t amount_pending;
+    unsigned long long size;            // disk space of all segments and indices
+    unsigned long long max_size;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long hit_bytes;       // bytes of the chunks that didn't have to be sent
+    unsigned long long evictions;       // results
+}chunk_cache;
+
+// opens (or creates) the cache directory and reads the indices of the segments within it, exits if it can't be created
+chunk_cache* chunk_cache_open(const char *dir, unsigned long long max_size);
+// hash of the chunk, the command is part of it
+chunk_key chunk_cache_key(const char *chunk, size_t len, MSG_TYPE command);
+// returns the result of the chunk (malloc'd, *len bytes) or NULL if it isn't cached, chunk_len counts towards the hit bytes
+char* chunk_cache_get(chunk_cache *cache, chunk_key key, size_t chunk_len, size_t *len);
+// stores the result of a chunk (buffered), the least recently used segments are evicted if the cache gets too big
+void chunk_cache_put(chunk_cache *cache, chunk_key key, const char *result, size_t len);
+// prints the hits and misses to stderr
+void chunk_cache_print_stats(chunk_cache *cache);
+// writes what's still buffered
+void chunk_cache_close(chunk_cache *cache);
@@ -0,0 +1,771 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../lib/word_ids.h"
+#include "./chunker.h"
+#include "./async_reader.h"
+
+struct input_mapping{
+    char *data;
+    size_t size;
+    bool mapped;                    // false -> data is a packed segment on the heap (or a range of the parent)
+    input_mapping *parent;          // the mapped file, if this is a range of it
+    atomic_size_t references;       // the chunker + every message that points into the mapping
+};
+
+// one piece of work of the readers, the segments reach the chunker in the order of the items
+typedef struct{
+    input_mapping *file;            // the item is a range of this mapped file (NULL -> it's read instead)
+    size_t start;                   // range within the file, before it is snapped to the words
+    size_t end;
+    size_t first_file;              // packed files or the file of the range
+    size_t amount_of_files;         // 0 -> the item is a range
+    size_t packed_size;             // size of the packed files + '\n' in between
+}read_item_t;
+
+struct file_readers{
+    input_files *files;
+    read_item_t *items;
+    size_t amount_of_items;
+    size_t next_item;               // next item a reader takes
+    size_t next_segment;            // next item the chunker takes
+    input_mapping *ready[SEGMENTS_AHEAD];   // segments of the items next_segment .. next_segment + SEGMENTS_AHEAD - 1, NULL if not read yet
+    bool stop;                      // the chunker is destroyed before everything has been read
+    bool use_io_uring;              // big files are read with io_uring instead of being mapped
+    bool streaming;                 // the segments come from a stream, they are items as soon as they are read
+    bool stream_ended;
+    unsigned long long stream_size; // bytes read from the stream
+    int fd;                         // the stream
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    pthread_t *threads;
+    int amount_of_threads;
+};
+
+static inline bool is_alpha(char c){
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+chunker* chunker_init(FILE *fp, unsigned long long file_size){
+    assert(fp);
+
+    chunker *input = (chunker *) calloc(1, sizeof(chunker));
+    if(!input){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+
+    input->fp = fp;
+    input->file_size = file_size;
+
+    // empty files and the ones that can't be mapped (pipes and such) are read instead
+    if(file_size == 0)
+        return input;
+    void *data = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if(data == MAP_FAILED)
+        return input;
+    madvise(data, file_size, MADV_SEQUENTIAL);
+
+    input->mapping = (input_mapping *) calloc(1, sizeof(input_mapping));
+    if(!input->mapping){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+    input->mapping->data = (char *) data;
+    input->mapping->size = file_size;
+    input->mapping->mapped = true;
+    atomic_init(&input->mapping->references, 1);
+    return input;
+}
+
+static input_mapping* new_mapping(char *data, size_t size, bool mapped){
+    input_mapping *mapping = (input_mapping *) calloc(1, sizeof(input_mapping));
+    if(!mapping){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+    mapping->data = data;
+    mapping->size = size;
+    mapping->mapped = mapped;
+    atomic_init(&mapping->references, 1);
+    return mapping;
+}
+
+// maps a big file, returns NULL if it can't be mapped
+static input_mapping* map_file(const char *path, size_t size){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return NULL;
+    madvise(data, size, MADV_SEQUENTIAL);
+    return new_mapping((char *) data, size, true);
+}
+
+// moves the offset to the start of the next word (or the end of the file), unless it's already at a word boundary
+// the reader of the range before does the same with its end, so every word ends up in exactly one range
+// a word that is longer than a chunk is split anyway, both readers only need to look MAX_CHUNK_LEN bytes ahead
+static size_t snap_to_word(const char *data, size_t size, size_t offset){
+    if(offset >= size)
+        return size;
+    size_t limit = offset + MAX_CHUNK_LEN;
+    while(offset > 0 && offset < size && offset < limit && is_alpha(data[offset]) && is_alpha(data[offset-1]))
+        offset++;
+    return offset;
+}
+
+// reads every page of the range, so it's in memory before the scheduler (and zmq) get to it
+static void fault_in(const char *data, size_t len){
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    volatile char touched = 0;
+    for(size_t i=0; i<len; i+=page)
+        touched = data[i];
+    (void) touched;
+}
+
+// reads a range of a file that isn't mapped, plus the byte before and MAX_CHUNK_LEN bytes after it to find the words
+static input_mapping* read_range(input_files *files, read_item_t *item, async_reader *reader){
+    size_t size = (size_t) files->sizes[item->first_file];
+    size_t window_start = item->start > 0 ? item->start - 1 : 0;
+    size_t window_end = size - item->end > MAX_CHUNK_LEN ? item->end + MAX_CHUNK_LEN : size;
+
+    char *window = (char *) malloc(window_end - window_start);
+    if(!window){
+        fprintf(stderr, "Could not allocate segment.\n");
+        exit(1);
+    }
+    read_request request = {open(files->paths[item->first_file], O_RDONLY), window, window_end - window_start, (off_t) window_start, 0};
+    if(request.fd < 0)
+        fprintf(stderr, "Could not open input file %s\n", files->paths[item->first_file]);
+    else{
+        read_requests(reader, &request, 1);
+        close(request.fd);
+    }
+
+    // the whole window, the segment is the part of it that belongs to the range
+    input_mapping *parent = new_mapping(window, request.done, false);
+    size_t start = snap_to_word(window, request.done, item->start - window_start);
+    size_t end = snap_to_word(window, request.done, item->end - window_start);
+    if(end < start)
+        end = start;
+    input_mapping *segment = new_mapping(&window[start], end - start, false);
+    segment->parent = parent;
+    return segment;
+}
+
+// reads the packed files, READ_BATCH of them at once
+static input_mapping* read_pack(input_files *files, read_item_t *item, async_reader *reader){
+    char *pack = (char *) malloc(item->packed_size > 0 ? item->packed_size : 1);
+    if(!pack){
+        fprintf(stderr, "Could not allocate segment.\n");
+        exit(1);
+    }
+
+    read_request requests[READ_BATCH];
+    size_t position = 0;        // where the next file goes if all files are as big as they were when they were listed
+    size_t packed = 0;          // actual end of the pack
+    for(size_t batch=0; batch<item->amount_of_files; batch+=READ_BATCH){
+        size_t amount = item->amount_of_files - batch < READ_BATCH ? item->amount_of_files - batch : READ_BATCH;
+        for(size_t i=0; i<amount; i++){
+            size_t nr = item->first_file + batch + i;
+            size_t len = (size_t)(files->sizes[nr] - files->starts[nr]);
+            requests[i] = (read_request){-1, &pack[position], 0, 0, 0};
+            if(len == 0)
+                continue;       // empty (or counted before), plan_items didn't count a '\n' for it either
+            if(position > 0)
+                position++;     // '\n' in between
+            requests[i] = (read_request){open(files->paths[nr], O_RDONLY), &pack[position], len, (off_t) files->starts[nr], 0};
+            if(requests[i].fd < 0){
+                fprintf(stderr, "Could not open input file %s\n", files->paths[nr]);
+                requests[i].len = 0;
+            }
+            position += len;
+        }
+        read_requests(reader, requests, amount);
+
+        // files that shrank leave gaps, they are closed here
+        for(size_t i=0; i<amount; i++){
+            if(requests[i].fd >= 0)
+                close(requests[i].fd);
+            if(requests[i].done == 0)
+                continue;
+            if(packed > 0)
+                pack[packed++] = '\n';
+            memmove(&pack[packed], requests[i].buffer, requests[i].done);
+            packed += requests[i].done;
+        }
+    }
+    return new_mapping(pack, packed, false);
+}
+
+// turns an item into a segment: a range of a file (the segment keeps the file alive) or the packed files
+static input_mapping* read_item(input_files *files, read_item_t *item, async_reader *reader){
+    if(item->amount_of_files > 0)
+        return read_pack(files, item, reader);
+    if(!item->file)
+        return read_range(files, item, reader);
+
+    const char *data = item->file->data;
+    size_t size = item->file->size;
+    size_t start = snap_to_word(data, size, item->start);
+    size_t end = snap_to_word(data, size, item->end);
+    if(end < start)
+        end = start;        // the range is within one word, the range before has it
+    fault_in(&data[start], end - start);
+
+    input_mapping *segment = new_mapping((char *) &data[start], end - start, false);
+    segment->parent = item->file;       // the item's reference
+    item->file = NULL;
+    return segment;
+}
+
+// every reader takes one item after the other, no reader gets more than SEGMENTS_AHEAD items ahead of the chunker
+static void* reader_thread(void *arg){
+    file_readers *readers = (file_readers *) arg;
+    async_reader *reader = readers->use_io_uring ? async_reader_init() : NULL;
+
+    while(true){
+        pthread_mutex_lock(&readers->lock);
+        while(!readers->stop && readers->next_item < readers->amount_of_items && readers->next_item >= readers->next_segment + SEGMENTS_AHEAD)
+            pthread_cond_wait(&readers->changed, &readers->lock);
+        size_t nr = readers->next_item;
+        if(readers->stop || nr >= readers->amount_of_items){
+            pthread_mutex_unlock(&readers->lock);
+            break;
+        }
+        readers->next_item++;
+        pthread_mutex_unlock(&readers->lock);
+
+        input_mapping *segment = read_item(readers->files, &readers->items[nr], reader);
+
+        pthread_mutex_lock(&readers->lock);
+        readers->ready[nr % SEGMENTS_AHEAD] = segment;
+        pthread_cond_broadcast(&readers->changed);
+        pthread_mutex_unlock(&readers->lock);
+    }
+    async_reader_destroy(reader);
+    return NULL;
+}
+
+static read_item_t* add_item(file_readers *readers){
+    readers->items = (read_item_t *) realloc(readers->items, (readers->amount_of_items + 1) * sizeof(read_item_t));
+    if(!readers->items){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+    read_item_t *item = &readers->items[readers->amount_of_items++];
+    memset(item, 0, sizeof(read_item_t));
+    return item;
+}
+
+// big files are split into ranges (mapped ones if there is no io_uring), the small ones in between are packed together
+static void plan_items(file_readers *readers){
+    input_files *files = readers->files;
+    read_item_t *pack = NULL;       // last item, if it packs files
+    for(size_t i=0; i<files->amount; i++){
+        size_t size = (size_t) files->sizes[i];
+        size_t skipped = (size_t) files->starts[i];     // counted before, it ends at a word boundary
+        size_t remaining = size - skipped;
+        if(remaining == 0)
+            continue;
+
+        if(remaining >= SEGMENT_LEN / 2 && readers->use_io_uring){
+            for(size_t start=skipped; start<size; start+=RANGE_LEN){
+                read_item_t *item = add_item(readers);
+                item->first_file = i;
+                item->start = start;
+                item->end = size - start > RANGE_LEN ? start + RANGE_LEN : size;
+            }
+            pack = NULL;
+            continue;
+        }
+
+        input_mapping *file = remaining >= SEGMENT_LEN / 2 ? map_file(files->paths[i], size) : NULL;
+        if(file){
+            for(size_t start=skipped; start<size; start+=RANGE_LEN){
+                read_item_t *item = add_item(readers);
+                item->file = (input_mapping *) chunker_retain(file);
+                item->start = start;
+                item->end = size - start > RANGE_LEN ? start + RANGE_LEN : size;
+            }
+            chunker_release(NULL, file);        // the ranges keep it alive
+            pack = NULL;
+            continue;
+        }
+
+        // files that can't be mapped are packed on their own
+        if(!pack || pack->packed_size + 1 + remaining > SEGMENT_LEN || remaining >= SEGMENT_LEN / 2){
+            pack = add_item(readers);
+            pack->first_file = i;
+        }
+        else{
+            pack->packed_size++;      // '\n' in between
+        }
+        pack->amount_of_files = i - pack->first_file + 1;
+        pack->packed_size += remaining;
+        if(remaining >= SEGMENT_LEN / 2)
+            pack = NULL;
+    }
+}
+
+static void start_readers(file_readers *readers, int amount_of_readers, void* (*thread)(void *)){
+    readers->amount_of_threads = amount_of_readers;
+    readers->threads = (pthread_t *) calloc((size_t) amount_of_readers, sizeof(pthread_t));
+    if(!readers->threads){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+    // deadlines are CLOCK_MONOTONIC
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    pthread_mutex_init(&readers->lock, NULL);
+    pthread_cond_init(&readers->changed, &attributes);
+    pthread_condattr_destroy(&attributes);
+    for(int i=0; i<amount_of_readers; i++){
+        if(pthread_create(&readers->threads[i], NULL, thread, readers) != 0){
+            fprintf(stderr, "Could not start reader thread.\n");
+            exit(1);
+        }
+    }
+}
+
+chunker* chunker_init_files(input_files *files, int amount_of_readers){
+    assert(files);
+    assert(amount_of_readers > 0);
+
+    chunker *input = (chunker *) calloc(1, sizeof(chunker));
+    file_readers *readers = (file_readers *) calloc(1, sizeof(file_readers));
+    if(!input || !readers){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+
+    // packed files get a '\n' in between, close enough for chunker_remaining
+    input->file_size = files->total_size + files->amount;
+    input->readers = readers;
+
+    // every reader gets its own ring, this one only checks if the kernel lets us use io_uring
+    async_reader *probe = async_reader_init();
+    readers->use_io_uring = probe != NULL;
+    async_reader_destroy(probe);
+
+    readers->files = files;
+    plan_items(readers);
+    if((size_t) amount_of_readers > readers->amount_of_items)
+        amount_of_readers = readers->amount_of_items > 0 ? (int) readers->amount_of_items : 1;
+    start_readers(readers, amount_of_readers, reader_thread);
+    return input;
+}
+
+// returns where the partial word at the end of the data starts (len if the data doesn't end within a word)
+static size_t last_word_start(const char *data, size_t len){
+    if(len == 0 || !is_alpha(data[len-1]))
+        return len;
+    size_t start = len - 1;
+    while(start > 0 && is_alpha(data[start-1]))
+        start--;
+    return start;
+}
+
+// true if a read wouldn't block (a pipe that has more data or a file)
+static bool more_available(int fd){
+    struct pollfd item = {fd, POLLIN, 0};
+    return poll(&item, 1, 0) > 0;
+}
+
+// reads the stream in segments of SEGMENT_LEN, the partial word at the end of a segment is carried over to the next one
+static void* stream_thread(void *arg){
+    file_readers *readers = (file_readers *) arg;
+
+    char *data = (char *) malloc(SEGMENT_LEN);
+    if(!data){
+        fprintf(stderr, "Could not allocate segment.\n");
+        exit(1);
+    }
+    size_t len = 0;
+    unsigned long long total = 0;
+    bool eof = false;
+    while(true){
+        while(len < SEGMENT_LEN){
+            ssize_t bytes = read(readers->fd, &data[len], SEGMENT_LEN - len);
+            if(bytes < 0 && errno == EINTR)
+                continue;
+            if(bytes <= 0){
+                if(bytes < 0)
+                    fprintf(stderr, "Could not read from input stream.\n");
+                eof = true;
+                break;
+            }
+            len += (size_t) bytes;
+            total += (unsigned long long) bytes;
+
+            // a live stream (logs, chat): what's there is handed out right away instead of waiting for a full segment
+            if(!more_available(readers->fd) && last_word_start(data, len) > 0)
+                break;
+        }
+
+        size_t cut = eof ? len : last_word_start(data, len);
+        if(cut == 0 && !eof){
+            fprintf(stderr, "Could not find word boundary in segment. Splitting word.\n");
+            cut = len;
+        }
+        char *next = NULL;
+        if(!eof){
+            next = (char *) malloc(SEGMENT_LEN);
+            if(!next){
+                fprintf(stderr, "Could not allocate segment.\n");
+                exit(1);
+            }
+            memcpy(next, &data[cut], len - cut);
+        }
+
+        pthread_mutex_lock(&readers->lock);
+        while(!readers->stop && readers->amount_of_items >= readers->next_segment + SEGMENTS_AHEAD)
+            pthread_cond_wait(&readers->changed, &readers->lock);
+        bool stop = readers->stop;
+        if(!stop && cut > 0){
+            readers->ready[readers->amount_of_items % SEGMENTS_AHEAD] = new_mapping(data, cut, false);
+            readers->amount_of_items++;
+            pthread_cond_broadcast(&readers->changed);
+        }
+        else{
+            free(data);
+        }
+        pthread_mutex_unlock(&readers->lock);
+
+        if(stop || eof){
+            free(next);
+            break;
+        }
+        len -= cut;
+        data = next;
+    }
+
+    pthread_mutex_lock(&readers->lock);
+    readers->stream_ended = true;
+    readers->stream_size = total;
+    pthread_cond_broadcast(&readers->changed);
+    pthread_mutex_unlock(&readers->lock);
+    return NULL;
+}
+
+chunker* chunker_init_stream(int fd){
+    chunker *input = (chunker *) calloc(1, sizeof(chunker));
+    file_readers *readers = (file_readers *) calloc(1, sizeof(file_readers));
+    if(!input || !readers){
+        fprintf(stderr, "Could not allocate chunker.\n");
+        exit(1);
+    }
+
+    input->readers = readers;
+    readers->streaming = true;
+    readers->fd = fd;
+    start_readers(readers, 1, stream_thread);
+    return input;
+}
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static bool pane_is_over(chunker *input){
+    return input->deadline > 0 && now_ms() >= input->deadline;
+}
+
+// the current segment is chunked -> takes the segment of the next item, returns false if there is none
+// if wait is set, it waits for the readers (until the deadline, if there is one), otherwise only a segment that's ready is taken
+static bool next_segment(chunker *input, bool wait){
+    file_readers *readers = input->readers;
+    pthread_mutex_lock(&readers->lock);
+    size_t nr = readers->next_segment;
+    while(wait && !readers->ready[nr % SEGMENTS_AHEAD] && (nr < readers->amount_of_items || (readers->streaming && !readers->stream_ended))){
+        if(input->deadline <= 0){
+            pthread_cond_wait(&readers->changed, &readers->lock);
+            continue;
+        }
+        struct timespec until = {(time_t)(input->deadline / 1000), (long)((input->deadline - (time_t)(input->deadline / 1000) * 1000.0) * 1e6)};
+        if(pthread_cond_timedwait(&readers->changed, &readers->lock, &until) == ETIMEDOUT)
+            break;
+    }
+    input_mapping *segment = NULL;
+    if(readers->ready[nr % SEGMENTS_AHEAD]){
+        segment = readers->ready[nr % SEGMENTS_AHEAD];
+        readers->ready[nr % SEGMENTS_AHEAD] = NULL;
+        readers->next_segment++;
+        pthread_cond_broadcast(&readers->changed);
+    }
+    pthread_mutex_unlock(&readers->lock);
+
+    if(!segment)
+        return false;
+    if(input->mapping)
+        chunker_release(NULL, input->mapping);     // tasks that point into it keep it alive
+    input->mapping = segment;
+    input->position = 0;
+    return true;
+}
+
+// reads from the file until the buffer is full or the file ends
+static void fill_buffer(chunker *input){
+    while(!input->eof && input->buffered < sizeof(input->buffer)){
+        size_t read = fread(&input->buffer[input->buffered], 1, sizeof(input->buffer) - input->buffered, input->fp);
+        if(read == 0){
+            if(ferror(input->fp))
+                fprintf(stderr, "Could not read from input file.\n");
+            input->eof = true;
+        }
+        input->buffered += read;
+    }
+}
+
+bool chunker_is_done(chunker *input){
+    assert(input);
+    if(input->readers){
+        while(!pane_is_over(input) && (!input->mapping || input->position >= input->mapping->size)){
+            if(!next_segment(input, true))
+                break;
+        }
+        return pane_is_over(input) || !input->mapping || input->position >= input->mapping->size;
+    }
+    if(input->mapping)
+        return input->position >= input->mapping->size;
+    fill_buffer(input);
+    return input->buffered == 0;
+}
+
+bool chunker_has_next(chunker *input){
+    assert(input);
+    if(!input->readers)
+        return !chunker_is_done(input);
+    if(pane_is_over(input))
+        return false;
+    while(!input->mapping || input->position >= input->mapping->size){
+        if(!next_segment(input, false))
+            return false;
+    }
+    return true;
+}
+
+bool chunker_is_finished(chunker *input){
+    assert(input);
+    if(!input->readers)
+        return chunker_is_done(input);
+    if(chunker_has_next(input))
+        return false;
+    if(pane_is_over(input))
+        return true;
+
+    file_readers *readers = input->readers;
+    pthread_mutex_lock(&readers->lock);
+    bool finished = readers->next_segment >= readers->amount_of_items && (!readers->streaming || readers->stream_ended);
+    pthread_mutex_unlock(&readers->lock);
+    return finished;
+}
+
+void chunker_set_deadline(chunker *input, double deadline_ms){
+    assert(input);
+    assert(input->readers);
+    input->deadline = deadline_ms;
+}
+
+void chunker_set_content_defined(chunker *input, bool content_defined){
+    assert(input);
+    input->content_defined = content_defined;
+}
+
+void chunker_set_word_ids(chunker *input, bool word_ids){
+    assert(input);
+    input->word_ids = word_ids;
+}
+
+void chunker_set_split_len(chunker *input, size_t split_len){
+    assert(input);
+    assert(split_len > 0 && split_len <= MAX_CHUNK_LEN);
+    input->split_len = split_len;
+}
+
+// returns true if a chunk may start at data[pos] (pos > 0): a word starts there or, with word IDs, an entry
+static inline bool starts_chunk(const chunker *input, const char *data, size_t pos){
+    if(input->word_ids)
+        return (is_alpha(data[pos]) || is_id_byte(data[pos])) && is_count_byte(data[pos-1]);
+    return is_alpha(data[pos]) && !is_alpha(data[pos-1]);
+}
+
+// returns true if the word that starts at data[pos] starts a chunk (content defined), pos >= CUT_WINDOW
+static bool is_cut_point(const char *data, size_t pos){
+    uint64_t hash = 0xcbf29ce484222325ULL;     // FNV-1a
+    for(size_t i=pos-CUT_WINDOW; i<pos; i++){
+        hash ^= (unsigned char) data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return (hash >> 32) % CUT_SPACING == 0;
+}
+
+// returns the length of the next chunk of the available bytes
+// available is the amount of bytes in data, the chunk is longer than max_len only if no word starts within it (up to the
+// split length)
+static size_t chunk_len(const chunker *input, const char *data, size_t available, size_t max_len){
+    if(available <= max_len)
+        return available;
+
+    // cut right before the first word behind the first half that is a cut point (if there is one)
+    if(input->content_defined){
+        size_t start = max_len / 2 > CUT_WINDOW ? max_len / 2 : CUT_WINDOW;
+        for(size_t len=start; len<=max_len; len++){
+            if(starts_chunk(input, data, len) && is_cut_point(data, len))
+                return len;
+        }
+    }
+
+    // cut right before the last word that starts within the chunk
+    size_t len = max_len;
+    while(len > 0 && !starts_chunk(input, data, len))
+        len--;
+
+    // no word starts within the chunk (a long word, a long run of ones in the map results or no word at all)
+    // -> the chunk grows up to the next word, a reducer can't tell which word the ones at the start of a chunk belong to
+    if(len == 0){
+        size_t split_len = input->split_len > 0 ? input->split_len : MAX_CHUNK_LEN;
+        len = max_len;
+        while(len < available && len < split_len && !starts_chunk(input, data, len))
+            len++;
+        if(len < available && !starts_chunk(input, data, len))
+            fprintf(stderr, "Could not find word boundary in chunk. Splitting word.\n");
+    }
+    return len;
+}
+
+size_t chunker_next_view(chunker *input, const char **chunk, size_t max_len){
+    assert(input);
+    assert(chunk);
+    assert(max_len > 0 && max_len <= MAX_CHUNK_LEN);
+
+    if(input->readers && chunker_is_done(input))
+        return 0;
+    assert(input->mapping);
+
+    const char *data = &input->mapping->data[input->position];
+    size_t len = chunk_len(input, data, input->mapping->size - input->position, max_len);
+    *chunk = data;
+    input->position += len;
+    input->handed_out += len;
+    return len;
+}
+
+size_t chunker_next(chunker *input, char chunk[], size_t max_len){
+    assert(input);
+    assert(chunk);
+    assert(max_len > 0 && max_len <= MAX_CHUNK_LEN);
+
+    if(chunker_is_mapped(input)){
+        const char *view = NULL;
+        size_t len = chunker_next_view(input, &view, max_len);
+        memcpy(chunk, view, len);
+        chunk[len] = '\0';
+        return len;
+    }
+
+    fill_buffer(input);
+    size_t len = chunk_len(input, input->buffer, input->buffered, max_len);
+    memcpy(chunk, input->buffer, len);
+    chunk[len] = '\0';
+
+    input->buffered -= len;
+    memmove(input->buffer, &input->buffer[len], input->buffered);
+    input->handed_out += len;
+    return len;
+}
+
+bool chunker_is_mapped(chunker *input){
+    assert(input);
+    return input->mapping != NULL || input->readers != NULL;
+}
+
+input_mapping* chunker_mapping(chunker *input){
+    assert(input);
+    return input->mapping;
+}
+
+void* chunker_retain(input_mapping *mapping){
+    assert(mapping);
+    atomic_fetch_add(&mapping->references, 1);
+    return mapping;
+}
+
+void chunker_release(void *data, void *mapping){
+    (void) data;
+    input_mapping *map = (input_mapping *) mapping;
+    assert(map);
+    if(atomic_fetch_sub(&map->references, 1) == 1){
+        if(map->parent)
+            chunker_release(NULL, map->parent);
+        else if(map->mapped)
+            munmap(map->data, map->size);
+        else
+            free(map->data);
+        free(map);
+    }
+}
+
+unsigned long long chunker_remaining(chunker *input){
+    assert(input);
+    // the size of a stream is known once it has ended, until then there is always plenty left
+    if(input->readers && input->readers->streaming){
+        file_readers *readers = input->readers;
+        pthread_mutex_lock(&readers->lock);
+        bool ended = readers->stream_ended;
+        input->file_size = readers->stream_size;
+        pthread_mutex_unlock(&readers->lock);
+        if(!ended)
+            return ULLONG_MAX;
+    }
+    if(input->handed_out >= input->file_size)
+        return input->buffered;
+    return input->file_size - input->handed_out;
+}
+
+void chunker_destroy(chunker *input){
+    assert(input);
+    file_readers *readers = input->readers;
+    if(readers){
+        // readers that are still waiting for space give up
+        pthread_mutex_lock(&readers->lock);
+        readers->stop = true;
+        pthread_cond_broadcast(&readers->changed);
+        pthread_mutex_unlock(&readers->lock);
+        for(int i=0; i<readers->amount_of_threads; i++)
+            pthread_join(readers->threads[i], NULL);
+
+        for(size_t i=0; i<SEGMENTS_AHEAD; i++){
+            if(readers->ready[i])
+                chunker_release(NULL, readers->ready[i]);
+        }
+        for(size_t i=0; readers->items && i<readers->amount_of_items; i++){      // a stream has no items to read
+            if(readers->items[i].file)
+                chunker_release(NULL, readers->items[i].file);
+        }
+        free(readers->items);
+        pthread_mutex_destroy(&readers->lock);
+        pthread_cond_destroy(&readers->changed);
+        free(readers->threads);
+        free(readers);
+    }
+    if(input->mapping)
+        chunker_release(NULL, input->mapping);     // messages that are still queued keep it alive
+    free(input);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+// This header houses the chunker of the distributor
+// it cuts a file into tasks on demand, so the size of every task can be chosen when it is handed out
+// a chunk never splits a word and always starts with one, so "word111another11" is never split into "word11" and "1another11"
+// regular files are memory mapped, then a chunk can be handed out as a pointer into the mapping instead of a copy
+// it can also read many files at once (chunker_init_files): the big files are mapped and split into ranges, the small ones
+// are packed together, reader threads turn them into segments in parallel and the chunks are cut from one segment after the other
+// the readers use io_uring if they can (see async_reader.h), then the big files are read instead of mapped
+// a stream is read into segments by a single reader, the partial word at the end of one is carried over to the next one
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../lib/encoder.h"
+#include "./input_files.h"
+
+// largest chunk that fits into one message (3 chars command + NUL)
+#define MAX_CHUNK_LEN (MSG_LEN - 4)
+
+// small files are packed into segments of this size, files that are at least half as big are mapped
+#define SEGMENT_LEN (1 << 20)
+// mapped files are split into ranges of this size, every reader moves the start of its range to the next word
+#define RANGE_LEN (16 << 20)
+// small files that are opened and read at once
+#define READ_BATCH 64
+// amount of segments the readers may get ahead of the chunker
+#define SEGMENTS_AHEAD 8
+// content defined chunks end at one of CUT_SPACING word starts (on average), but never within the first half of max_len
+#define CUT_SPACING 32
+// amount of bytes in front of a word start, that decide whether the chunk ends there
+#define CUT_WINDOW 16
+
+// the mapped file (or a segment of packed files), it stays alive as long as the chunker or a message that points into it needs it
+typedef struct input_mapping input_mapping;
+
+// the reader threads of chunker_init_files
+typedef struct file_readers file_readers;
+
+typedef struct{
+    FILE *fp;
+    file_readers *readers;              // NULL if the chunker reads a single file
+    input_mapping *mapping;             // NULL if the file couldn't be mapped (then it's read into the buffer), current segment of the readers
+    unsigned long long position;        // offset of the next chunk within the mapping
+    char buffer[MAX_CHUNK_LEN + 1];     // bytes read from the file, that haven't been handed out yet
+    size_t buffered;
+    unsigned long long file_size;
+    unsigned long long handed_out;      // bytes that have been handed out as chunks
+    double deadline;                    // ms (CLOCK_MONOTONIC) after which no chunk is handed out anymore, 0 -> none
+    bool content_defined;               // see chunker_set_content_defined
+    bool word_ids;                      // see chunker_set_word_ids
+    size_t split_len;                   // see chunker_set_split_len (0 -> MAX_CHUNK_LEN)
+    bool eof;
+}chunker;
+
+// this func assumes the file is open with read privileges, the chunker doesn't close it
+chunker* chunker_init(FILE *fp, unsigned long long file_size);
+// reads all input files with amount_of_readers threads, the files have to stay alive until the chunker is destroyed
+chunker* chunker_init_files(input_files *files, int amount_of_readers);
+// reads a stream (a pipe, stdin) that can't be mapped or seeked, its size is unknown until it has ended
+chunker* chunker_init_stream(int fd);
+// returns true if every byte of the file has been handed out (waits for the readers if the next segment isn't ready yet)
+bool chunker_is_done(chunker *input);
+// returns true if a chunk can be handed out right away (doesn't wait for the readers)
+bool chunker_has_next(chunker *input);
+// returns true if no chunk will be handed out anymore (doesn't wait for the readers either), the deadline counts as the end
+bool chunker_is_finished(chunker *input);
+// lets the chunker end at the deadline (ms of CLOCK_MONOTONIC, 0 -> no deadline), what's left is handed out after the next one
+// only for the readers (chunker_init_files and chunker_init_stream)
+void chunker_set_deadline(chunker *input, double deadline_ms);
+// the chunks end where the bytes in front of a word start say so (instead of right before the last word within max_len)
+// then the same text is cut into the same chunks, even if something has been inserted or removed in front of it
+// (after a chunk or two the cuts are in sync again), this is what makes the chunks of a changed file hit the chunk cache
+void chunker_set_content_defined(chunker *input, bool content_defined);
+// the input is made of MAP results with word IDs (see word_ids.h), a chunk starts with an entry instead of a word
+void chunker_set_word_ids(chunker *input, bool word_ids);
+// a chunk that no word starts within grows up to the next word, but to split_len bytes at most (MAX_CHUNK_LEN by
+// default), a longer word is split there, for tasks that need room besides the chunk (see MAP_COMBINED and MAP_IDS)
+void chunker_set_split_len(chunker *input, size_t split_len);
+// copies the next chunk (at most max_len bytes, max_len <= MAX_CHUNK_LEN) into the buffer and NUL terminates it
+// returns the length of the chunk or 0 if there is nothing left
+size_t chunker_next(chunker *input, char chunk[], size_t max_len);
+// returns true if the file is mapped, only then chunker_next_view can be used
+bool chunker_is_mapped(chunker *input);
+// same as chunker_next, but *chunk points into the mapping (the chunk is NOT NUL terminated), nothing is copied
+size_t chunker_next_view(chunker *input, const char **chunk, size_t max_len);
+// returns the mapping of the last chunk handed out by chunker_next_view (NULL if it isn't mapped)
+input_mapping* chunker_mapping(chunker *input);
+// keeps the mapping alive until chunker_release is called, returns the argument for chunker_release
+// chunker_release has the signature of the free function of zmq_msg_init_data, so a message can point into the mapping
+void* chunker_retain(input_mapping *mapping);
+void chunker_release(void *data, void *mapping);
+// amount of bytes that haven't been handed out yet
+unsigned long long chunker_remaining(chunker *input);
+void chunker_destroy(chunker *input);
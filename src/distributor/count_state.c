@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../lib/encoder.h"
+#include "./chunker.h"
+#include "./count_state.h"
+
+// first line of a state file, the version goes up if the format changes
+#define STATE_HEADER "zmq_distributor state 3\n"
+// last line, a state without it is incomplete
+#define STATE_END "end\n"
+
+static inline bool is_alpha(char c){
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+static inline char to_lower(char c){
+    return c>='A' && c<='Z' ? c - 'A' + 'a' : c;
+}
+
+// FNV-1a over the file's first len bytes (and len itself), read front to back
+// returns false if the file can't be read that far
+static bool checksum(const char *path, unsigned long long len, uint64_t *sum){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    posix_fadvise(fd, 0, (off_t) len, POSIX_FADV_SEQUENTIAL);
+
+    char *buffer = (char *) malloc(CHECKSUM_BUFFER_LEN);
+    if(!buffer){
+        fprintf(stderr, "Could not allocate checksum buffer.\n");
+        exit(1);
+    }
+    uint64_t hash = 0xcbf29ce484222325ULL ^ len;
+    unsigned long long done = 0;
+    while(done < len){
+        size_t part = len - done < CHECKSUM_BUFFER_LEN ? (size_t)(len - done) : CHECKSUM_BUFFER_LEN;
+        ssize_t got = read(fd, buffer, part);
+        if(got <= 0)
+            break;
+        for(ssize_t j=0; j<got; j++){
+            hash ^= (unsigned char) buffer[j];
+            hash *= 0x100000001b3ULL;
+        }
+        done += (unsigned long long) got;
+    }
+    free(buffer);
+    close(fd);
+    *sum = hash;
+    return done == len;
+}
+
+// what the file looked like when the state was saved
+typedef struct{
+    unsigned long long size;
+    unsigned long long inode;
+    long long mtime_s;
+    long mtime_ns;
+}file_stamp;
+
+static bool stamp(const char *path, file_stamp *stamp){
+    struct stat info;
+    if(stat(path, &info) != 0)
+        return false;
+    stamp->size = (unsigned long long) info.st_size;
+    stamp->inode = (unsigned long long) info.st_ino;
+    stamp->mtime_s = (long long) info.st_mtim.tv_sec;
+    stamp->mtime_ns = info.st_mtim.tv_nsec;
+    return true;
+}
+
+// returns true if the file can only have been appended to since it had the stamp before (or hasn't been touched at all)
+static bool only_appended(const file_stamp *before, const file_stamp *now){
+    if(now->inode != before->inode || now->size < before->size)
+        return false;
+    // written to without growing -> an edit in place
+    return now->size > before->size || (now->mtime_s == before->mtime_s && now->mtime_ns == before->mtime_ns);
+}
+
+// returns where the word at the end of the file nr starts (its size if the file doesn't end within a word)
+// the word is at most MAX_CHUNK_LEN long, a longer one has been cut into pieces by the chunker anyway and stays counted
+// *word is set to the word (lowercase, like the workers count it)
+static unsigned long long last_boundary(input_files *files, size_t nr, char word[MSG_LEN]){
+    word[0] = '\0';
+    unsigned long long size = files->sizes[nr];
+    unsigned long long window_start = size - files->starts[nr] > MAX_CHUNK_LEN ? size - MAX_CHUNK_LEN : files->starts[nr];
+    size_t len = (size_t)(size - window_start);
+    if(len == 0)
+        return size;
+
+    char window[MAX_CHUNK_LEN];
+    int fd = open(files->paths[nr], O_RDONLY);
+    if(fd < 0)
+        return size;
+    bool complete = pread(fd, window, len, (off_t) window_start) == (ssize_t) len;
+    close(fd);
+    if(!complete || !is_alpha(window[len-1]))
+        return size;
+
+    size_t start = len - 1;
+    while(start > 0 && is_alpha(window[start-1]))
+        start--;
+    if(start == 0 && window_start > files->starts[nr])
+        return size;        // longer than the window
+
+    for(size_t i=start; i<len; i++)
+        word[i-start] = to_lower(window[i]);
+    word[len-start] = '\0';
+    return window_start + start;
+}
+
+// the files sorted by path, so the ones of the state are found quickly
+typedef struct{
+    const char *path;
+    size_t nr;
+}sorted_file;
+
+static int compare_paths(const void *a, const void *b){
+    return strcmp(((const sorted_file *) a)->path, ((const sorted_file *) b)->path);
+}
+
+// returns the first file with that path, that hasn't been matched yet (files->amount if there is none)
+static size_t find_file(input_files *files, sorted_file *sorted, bool *matched, const char *path){
+    size_t low = 0;
+    size_t high = files->amount;
+    while(low < high){
+        size_t middle = (low + high) / 2;
+        if(strcmp(sorted[middle].path, path) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for(; low < files->amount && !strcmp(sorted[low].path, path); low++){
+        if(!matched[sorted[low].nr])
+            return sorted[low].nr;
+    }
+    return files->amount;
+}
+
+// helper for count_state_resume
+static void add_counts(void *key, void *value, void *arg){
+    hashmap *counts = (hashmap *) arg;
+    int count = *(int *) value;
+    int before = 0;
+    if(hashmap_get(counts, key, &before))
+        count += before;
+    hashmap_put(counts, key, &count);
+}
+
+bool count_state_resume(const char *path, input_files *files, hashmap *counts){
+    assert(path);
+    assert(files);
+    assert(counts);
+
+    FILE *file = fopen(path, "r");
+    if(!file)
+        return false;       // first run
+
+    sorted_file *sorted = (sorted_file *) malloc((files->amount + 1) * sizeof(sorted_file));
+    bool *matched = (bool *) calloc(files->amount + 1, sizeof(bool));
+    unsigned long long *starts = (unsigned long long *) calloc(files->amount + 1, sizeof(unsigned long long));
+    hashmap *stored = hashmap_init(4096, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    if(!sorted || !matched || !starts){
+        fprintf(stderr, "Could not allocate state.\n");
+        exit(1);
+    }
+    for(size_t i=0; i<files->amount; i++)
+        sorted[i] = (sorted_file){files->paths[i], i};
+    qsort(sorted, files->amount, sizeof(sorted_file), compare_paths);
+
+    // paths and words are never longer than a line
+    char line[4096 + MSG_LEN + 64];
+    const char *problem = NULL;
+    unsigned long long amount_of_files = 0;
+    if(!fgets(line, sizeof(line), file) || strcmp(line, STATE_HEADER) != 0 ||
+       !fgets(line, sizeof(line), file) || sscanf(line, "files %llu", &amount_of_files) != 1)
+        problem = "it isn't a state file";
+
+    for(unsigned long long i=0; !problem && i<amount_of_files; i++){
+        unsigned long long offset = 0;
+        unsigned long long stored_sum = 0;
+        file_stamp before = {0};
+        file_stamp now = {0};
+        int path_start = 0;
+        if(!fgets(line, sizeof(line), file) ||
+           sscanf(line, "%llu %llx %llu %llu %lld.%ld %n", &offset, &stored_sum, &before.size, &before.inode, &before.mtime_s,
+                  &before.mtime_ns, &path_start) != 6 || path_start == 0){
+            problem = "it is broken";
+            break;
+        }
+        line[strcspn(line, "\n")] = '\0';
+
+        size_t nr = find_file(files, sorted, matched, &line[path_start]);
+        uint64_t sum = 0;
+        if(nr == files->amount){
+            fprintf(stderr, "%s isn't an input anymore\n", &line[path_start]);
+            problem = "the files have changed";
+            break;
+        }
+        if(offset > files->sizes[nr] || !stamp(files->paths[nr], &now) || !only_appended(&before, &now) ||
+           !checksum(files->paths[nr], offset, &sum) || sum != stored_sum){
+            fprintf(stderr, "%s has changed since the last run\n", &line[path_start]);
+            problem = "the files have changed";
+            break;
+        }
+        matched[nr] = true;
+        starts[nr] = offset;
+    }
+
+    // "word count" lines until the end
+    while(!problem){
+        char *space = NULL;
+        if(fgets(line, sizeof(line), file)){
+            if(!strcmp(line, STATE_END))
+                break;
+            space = strrchr(line, ' ');
+        }
+        if(!space || space - line >= MSG_LEN){
+            problem = "it is broken";
+            break;
+        }
+        char word[MSG_LEN] = {0};
+        memcpy(word, line, (size_t)(space - line));
+        int count = atoi(space + 1);
+        hashmap_put(stored, word, &count);
+    }
+    fclose(file);
+
+    if(problem)
+        fprintf(stderr, "Not using the state in %s (%s), everything is counted\n", path, problem);
+    else{
+        for(size_t i=0; i<files->amount; i++)
+            input_files_skip(files, i, starts[i]);
+        hashmap_for_each(stored, add_counts, counts);
+    }
+
+    hashmap_destroy(stored);
+    free(sorted);
+    free(matched);
+    free(starts);
+    return !problem;
+}
+
+typedef struct{
+    FILE *file;
+    hashmap *partial;       // words at the ends of the files, they aren't part of the state
+}save_arg;
+
+// helper for count_state_save
+static void write_count(void *key, void *value, void *arg){
+    save_arg *save = (save_arg *) arg;
+    int count = *(int *) value;
+    int partial = 0;
+    if(hashmap_get(save->partial, key, &partial))
+        count -= partial;
+    if(count > 0 && ((char *) key)[0] != '\0')
+        fprintf(save->file, "%s %d\n", (char *) key, count);
+}
+
+void count_state_save(const char *path, input_files *files, hashmap *counts){
+    assert(path);
+    assert(files);
+    assert(counts);
+
+    // the words at the ends of the files may go on in the next run, they are counted again then
+    hashmap *partial = hashmap_init(64, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    unsigned long long *offsets = (unsigned long long *) calloc(files->amount + 1, sizeof(unsigned long long));
+    if(!offsets){
+        fprintf(stderr, "Could not allocate state.\n");
+        exit(1);
+    }
+    for(size_t i=0; i<files->amount; i++){
+        char word[MSG_LEN];
+        offsets[i] = last_boundary(files, i, word);
+        if(word[0] != '\0'){
+            int count = 1;
+            int before = 0;
+            if(hashmap_get(partial, word, &before))
+                count += before;
+            hashmap_put(partial, word, &count);
+        }
+    }
+
+    // written under another name first, so a crash never leaves half a state behind
+    char temp_path[4096 + 32];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld", path, (long) getpid());
+    FILE *file = fopen(temp_path, "w");
+    if(!file){
+        fprintf(stderr, "Could not write state to %s\n", path);
+        exit(1);
+    }
+
+    fputs(STATE_HEADER, file);
+    fprintf(file, "files %zu\n", files->amount);
+    for(size_t i=0; i<files->amount; i++){
+        uint64_t sum = 0;
+        file_stamp now = {0};
+        checksum(files->paths[i], offsets[i], &sum);
+        stamp(files->paths[i], &now);
+        fprintf(file, "%llu %016llx %llu %llu %lld.%09ld %s\n", offsets[i], (unsigned long long) sum, now.size, now.inode,
+                now.mtime_s, now.mtime_ns, files->paths[i]);
+    }
+
+    save_arg save = {file, partial};
+    hashmap_for_each(counts, write_count, &save);
+    fputs(STATE_END, file);
+
+    if(fclose(file) != 0 || rename(temp_path, path) != 0){
+        unlink(temp_path);
+        fprintf(stderr, "Could not write state to %s\n", path);
+        exit(1);
+    }
+    hashmap_destroy(partial);
+    free(offsets);
+}
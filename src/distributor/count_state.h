@@ -0,0 +1,22 @@
+#pragma once
+
+// This header houses the state of earlier runs over append-only inputs (--state <file>)
+// after a run the counts are saved together with the offset up to which every file has been counted and a checksum of
+// the bytes in front of it, a later run over the same files only reads what has been appended since and adds it to them
+// the offset is the last word boundary of a file, a word that is still being written is counted again once it's complete
+// if a file has changed in front of its offset (or is gone), the counts can't be taken apart anymore -> everything is counted again
+// the checksum covers the whole counted part, reading it again is sequential I/O and still much cheaper than counting it
+// the inode, size and mtime of every file are saved too: a file that has been replaced, has shrunk or has been written
+// to without growing is counted again completely without reading it first
+#include <stdbool.h>
+#include "../lib/hashmap.h"
+#include "./input_files.h"
+
+// bytes the checksum reads at once
+#define CHECKSUM_BUFFER_LEN (1 << 20)
+
+// loads the state saved at path into counts and lets the files skip what has been counted before
+// returns false (and leaves both as they are) if there is no state yet or it doesn't match the files anymore
+bool count_state_resume(const char *path, input_files *files, hashmap *counts);
+// saves the counts of the files (every byte of them up to their sizes has been counted) to path
+void count_state_save(const char *path, input_files *files, hashmap *counts);
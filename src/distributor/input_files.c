@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <glob.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "./input_files.h"
+
+static void add_file(input_files *files, const char *path, unsigned long long size){
+    if(files->amount == files->capacity){
+        files->capacity = files->capacity ? files->capacity * 2 : 64;
+        files->paths = (char **) realloc(files->paths, files->capacity * sizeof(char *));
+        files->sizes = (unsigned long long *) realloc(files->sizes, files->capacity * sizeof(unsigned long long));
+        files->starts = (unsigned long long *) realloc(files->starts, files->capacity * sizeof(unsigned long long));
+        if(!files->paths || !files->sizes || !files->starts){
+            fprintf(stderr, "Could not allocate memory for the input files.\n");
+            exit(1);
+        }
+    }
+
+    files->paths[files->amount] = strdup(path);
+    if(!files->paths[files->amount]){
+        fprintf(stderr, "Could not allocate memory for the input files.\n");
+        exit(1);
+    }
+    files->sizes[files->amount] = size;
+    files->starts[files->amount] = 0;
+    files->amount++;
+    files->total_size += size;
+}
+
+static int compare_names(const void *a, const void *b){
+    return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+// adds a regular file or everything within a directory, returns the amount of files added
+static size_t add_path(input_files *files, const char *path){
+    struct stat info;
+    if(stat(path, &info) != 0)
+        return 0;
+
+    if(S_ISREG(info.st_mode)){
+        add_file(files, path, (unsigned long long) info.st_size);
+        return 1;
+    }
+    if(!S_ISDIR(info.st_mode))
+        return 0;
+
+    DIR *dir = opendir(path);
+    if(!dir){
+        fprintf(stderr, "Could not open directory %s\n", path);
+        return 0;
+    }
+
+    // collect the names first, so they can be sorted
+    char **names = NULL;
+    size_t amount_of_names = 0;
+    struct dirent *entry;
+    while((entry = readdir(dir))){
+        if(entry->d_name[0] == '.')
+            continue;       // ., .. and hidden files
+        names = (char **) realloc(names, (amount_of_names + 1) * sizeof(char *));
+        if(!names){
+            fprintf(stderr, "Could not allocate memory for the input files.\n");
+            exit(1);
+        }
+        names[amount_of_names] = (char *) malloc(strlen(path) + strlen(entry->d_name) + 2);
+        if(!names[amount_of_names]){
+            fprintf(stderr, "Could not allocate memory for the input files.\n");
+            exit(1);
+        }
+        sprintf(names[amount_of_names], "%s/%s", path, entry->d_name);
+        amount_of_names++;
+    }
+    closedir(dir);
+
+    qsort(names, amount_of_names, sizeof(char *), compare_names);
+    size_t added = 0;
+    for(size_t i=0; i<amount_of_names; i++){
+        added += add_path(files, names[i]);
+        free(names[i]);
+    }
+    free(names);
+    return added;
+}
+
+input_files* input_files_find(char *inputs[], size_t amount_of_inputs, const char **missing){
+    assert(inputs);
+
+    input_files *files = (input_files *) calloc(1, sizeof(input_files));
+    if(!files){
+        fprintf(stderr, "Could not allocate memory for the input files.\n");
+        exit(1);
+    }
+
+    for(size_t i=0; i<amount_of_inputs; i++){
+        size_t added = 0;
+        if(strpbrk(inputs[i], "*?[")){
+            glob_t matches;
+            if(glob(inputs[i], 0, NULL, &matches) == 0){
+                for(size_t j=0; j<matches.gl_pathc; j++)
+                    added += add_path(files, matches.gl_pathv[j]);
+            }
+            globfree(&matches);
+        }
+
+        // a file can have a '*' in its name too
+        if(added == 0)
+            added = add_path(files, inputs[i]);
+
+        // an empty directory is fine, a missing file isn't
+        struct stat info;
+        if(added == 0 && !(stat(inputs[i], &info) == 0 && S_ISDIR(info.st_mode))){
+            if(missing)
+                *missing = inputs[i];
+            input_files_destroy(files);
+            return NULL;
+        }
+    }
+    return files;
+}
+
+input_files* input_files_expand(char *inputs[], size_t amount_of_inputs){
+    input_files *files = input_files_find(inputs, amount_of_inputs, NULL);
+    if(!files){
+        fprintf(stderr, "Could not open file\n");
+        exit(1);
+    }
+    return files;
+}
+
+void input_files_skip(input_files *files, size_t nr, unsigned long long start){
+    assert(files);
+    assert(nr < files->amount);
+    assert(start <= files->sizes[nr]);
+
+    files->total_size -= start - files->starts[nr];
+    files->starts[nr] = start;
+}
+
+void input_files_destroy(input_files *files){
+    assert(files);
+    for(size_t i=0; i<files->amount; i++)
+        free(files->paths[i]);
+    free(files->paths);
+    free(files->sizes);
+    free(files->starts);
+    free(files);
+}
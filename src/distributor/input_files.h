@@ -0,0 +1,22 @@
+#pragma once
+
+// This header houses the expansion of the inputs of the distributor
+// every input can be a file, a directory (all regular files within it, recursively) or a glob pattern ("books/*.txt")
+#include <stddef.h>
+
+typedef struct{
+    char **paths;                       // sorted per input, so the order is always the same
+    unsigned long long *sizes;          // size of each file when it has been expanded
+    unsigned long long *starts;         // bytes at the start of each file that have been counted before (see count_state.h), 0 by default
+    size_t amount;
+    size_t capacity;
+    unsigned long long total_size;      // bytes that are read (the starts aren't)
+}input_files;
+
+// returns NULL if an input can't be opened or a pattern doesn't match anything (*missing is set to it, if missing isn't NULL)
+input_files* input_files_find(char *inputs[], size_t amount_of_inputs, const char **missing);
+// same, but exits if an input can't be opened or a pattern doesn't match anything
+input_files* input_files_expand(char *inputs[], size_t amount_of_inputs);
+// only the bytes from start on are read of the file nr (start <= its size)
+void input_files_skip(input_files *files, size_t nr, unsigned long long start);
+void input_files_destroy(input_files *files);
@@ -0,0 +1,467 @@
+#include <zmq.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <assert.h>
+#include "../lib/hashmap.h"
+#include "./chunker.h"
+#include "./input_files.h"
+#include "./word_count.h"
+#include "./reduce_tree.h"
+#include "./job_server.h"
+
+// longest command of a request ("shutdown" or "count:<priority>")
+#define COMMAND_LEN 64
+// how long the last replies may take to reach their clients on shutdown (ms)
+#define REPLY_LINGER_MS 1000
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signal_nr){
+    (void) signal_nr;
+    stop_requested = 1;
+}
+
+// client a reply goes to (routing id of the ROUTER socket)
+typedef struct{
+    char identity[IDENTITY_LEN];
+    size_t identity_len;
+    bool delimiter;             // REQ clients put an empty frame in front of the request, the reply needs one too
+}client;
+
+typedef struct{
+    zmq_msg_t *frames;
+    size_t amount;
+    size_t capacity;
+    client from;
+    size_t body;                // index of the first frame behind the envelope (the command)
+}request;
+
+// a running job, it goes through its MAP phase and its RED phase (a phase per level with a tree) and is answered after that
+typedef struct{
+    client to;
+    input_files *files;         // count jobs
+    zmq_msg_t text;             // text jobs, the input is read right from the message
+    FILE *text_file;
+    chunker *input;             // of the MAP phase
+    FILE *map_results;
+    hashmap *counts;            // word -> count, only this job's RED results end up here
+    reduce_tree tree;           // of the RED phase
+    double priority;
+    bool reducing;
+    scheduler_phase phase;
+}job;
+
+typedef struct{
+    void *socket;               // ROUTER
+    job **jobs;
+    size_t amount_of_jobs;
+    size_t capacity;
+    int amount_of_readers;
+    scheduler *sched;               // the jobs are counted with word IDs if it has a dictionary
+    char *root;                 // count requests can't reach outside of it (resolved, NULL -> every file the process can read)
+    count_options options;
+    bool stopping;              // a shutdown has been requested, the running jobs are finished first
+}job_server;
+
+static void request_close(request *req){
+    for(size_t i=0; i<req->amount; i++)
+        zmq_msg_close(&req->frames[i]);
+    free(req->frames);
+    memset(req, 0, sizeof(request));
+}
+
+// receives all frames of the next request without waiting for one, returns false if there is none
+// the frames of a request arrive at once, so only the first one can be missing
+static bool receive_request(void *socket, request *req){
+    int more = 1;
+    size_t more_size = sizeof(more);
+    while(more){
+        if(req->amount == req->capacity){
+            req->capacity = req->capacity ? req->capacity * 2 : 8;
+            req->frames = (zmq_msg_t *) realloc(req->frames, req->capacity * sizeof(zmq_msg_t));
+            if(!req->frames){
+                fprintf(stderr, "Could not allocate request.\n");
+                exit(1);
+            }
+        }
+
+        zmq_msg_t *frame = &req->frames[req->amount];
+        zmq_msg_init(frame);
+        while(zmq_msg_recv(frame, socket, req->amount == 0 ? ZMQ_DONTWAIT : 0) < 0){
+            if(zmq_errno() == EAGAIN && req->amount == 0){
+                zmq_msg_close(frame);
+                return false;
+            }
+            if(zmq_errno() != EINTR){
+                fprintf(stderr, "Could not receive request: %s\n", zmq_strerror(zmq_errno()));
+                exit(1);
+            }
+        }
+        req->amount++;
+        zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size);
+    }
+
+    // [identity][][command]... from REQ clients, [identity][command]... from DEALER clients
+    size_t identity_len = zmq_msg_size(&req->frames[0]);
+    req->from.identity_len = identity_len < IDENTITY_LEN ? identity_len : IDENTITY_LEN;
+    memcpy(req->from.identity, zmq_msg_data(&req->frames[0]), req->from.identity_len);
+    req->from.delimiter = req->amount > 1 && zmq_msg_size(&req->frames[1]) == 0;
+    req->body = req->from.delimiter ? 2 : 1;
+    return true;
+}
+
+// copies a frame into a NUL terminated string (malloc'd)
+static char* frame_to_string(zmq_msg_t *frame){
+    size_t len = zmq_msg_size(frame);
+    char *str = (char *) malloc(len + 1);
+    if(!str){
+        fprintf(stderr, "Could not allocate request.\n");
+        exit(1);
+    }
+    memcpy(str, zmq_msg_data(frame), len);
+    str[len] = '\0';
+    return str;
+}
+
+// a client that is gone doesn't get its reply (the ROUTER drops it)
+static void send_reply(void *socket, client *to, const char *status, const char *body, size_t len){
+    zmq_send(socket, to->identity, to->identity_len, ZMQ_SNDMORE);
+    if(to->delimiter)
+        zmq_send(socket, "", 0, ZMQ_SNDMORE);
+    zmq_send(socket, status, strlen(status), ZMQ_SNDMORE);
+    zmq_send(socket, body, len, 0);
+}
+
+static void send_error(void *socket, client *to, const char *message){
+    send_reply(socket, to, "error", message, strlen(message));
+}
+
+static job* new_job(request *req, double priority){
+    job *new = (job *) calloc(1, sizeof(job));
+    if(!new){
+        fprintf(stderr, "Could not allocate job.\n");
+        exit(1);
+    }
+    new->to = req->from;
+    new->priority = priority;
+    new->counts = word_counts_init();
+    zmq_msg_init(&new->text);
+    new->map_results = tmpfile();
+    if(!new->map_results){
+        fprintf(stderr, "Failed to create temporary file for MAP results with write privileges.\n");
+        exit(1);
+    }
+    return new;
+}
+
+static void add_job(job_server *server, job *new){
+    if(server->amount_of_jobs == server->capacity){
+        server->capacity = server->capacity ? server->capacity * 2 : 8;
+        server->jobs = (job **) realloc(server->jobs, server->capacity * sizeof(job *));
+        if(!server->jobs){
+            fprintf(stderr, "Could not allocate jobs.\n");
+            exit(1);
+        }
+    }
+    MSG_TYPE command = map_command(server->sched, &server->options);
+    scheduler_phase_init(&new->phase, new->input, command, new->priority, save_map_result, new->map_results);
+    server->jobs[server->amount_of_jobs++] = new;
+}
+
+// frees the input of the MAP phase (files or text), it isn't needed anymore once every chunk has been mapped
+static void close_job_input(job *current){
+    if(current->input)
+        chunker_destroy(current->input);
+    if(current->files)
+        input_files_destroy(current->files);
+    if(current->text_file)
+        fclose(current->text_file);
+    zmq_msg_close(&current->text);
+    zmq_msg_init(&current->text);
+    current->input = NULL;
+    current->files = NULL;
+    current->text_file = NULL;
+}
+
+static void destroy_job(job *current){
+    close_job_input(current);
+    zmq_msg_close(&current->text);
+    scheduler_phase_destroy(&current->phase);
+    if(current->map_results)
+        fclose(current->map_results);
+    reduce_tree_destroy(&current->tree);
+    hashmap_destroy(current->counts);
+    free(current);
+}
+
+// returns true if the path leads to the root or somewhere within it (after resolving symlinks and "..")
+static bool within_root(const char *root, const char *path){
+    char *resolved = realpath(path, NULL);
+    if(!resolved)
+        return false;
+    size_t len = strlen(root);
+    bool within = !strncmp(resolved, root, len) && (resolved[len] == '/' || resolved[len] == '\0' || root[len-1] == '/');
+    free(resolved);
+    return within;
+}
+
+// a relative path of a request is relative to the root (if there is one)
+static char* request_path(job_server *server, zmq_msg_t *frame){
+    char *path = frame_to_string(frame);
+    if(!server->root || path[0] == '/')
+        return path;
+
+    char *joined = (char *) malloc(strlen(server->root) + strlen(path) + 2);
+    if(!joined){
+        fprintf(stderr, "Could not allocate request.\n");
+        exit(1);
+    }
+    sprintf(joined, "%s/%s", server->root, path);
+    free(path);
+    return joined;
+}
+
+// ["count", <path>...] -> starts counting all files, returns NULL if one of them doesn't exist (error is set)
+// with a root every file has to be within it, the error is the same as for a missing one, so a client can't find out
+// what exists outside of it
+static job* start_count(job_server *server, request *req, double priority, char *error, size_t error_len){
+    if(req->amount < req->body + 2){
+        snprintf(error, error_len, "count needs at least one file, directory or pattern");
+        return NULL;
+    }
+
+    size_t amount_of_inputs = req->amount - req->body - 1;
+    char *inputs[amount_of_inputs];
+    for(size_t i=0; i<amount_of_inputs; i++)
+        inputs[i] = request_path(server, &req->frames[req->body + 1 + i]);
+
+    job *new = NULL;
+    const char *missing = NULL;
+    input_files *files = input_files_find(inputs, amount_of_inputs, &missing);
+    for(size_t i=0; files && server->root && i<files->amount; i++){
+        if(!within_root(server->root, files->paths[i])){
+            snprintf(error, error_len, "Could not open %s within the root directory", files->paths[i]);
+            input_files_destroy(files);
+            files = NULL;
+        }
+    }
+    if(files){
+        new = new_job(req, priority);
+        new->files = files;
+        new->input = chunker_init_files(files, server->amount_of_readers);
+    }
+    else if(missing){
+        snprintf(error, error_len, server->root ? "Could not open %s within the root directory" : "Could not open %s", missing);
+    }
+
+    for(size_t i=0; i<amount_of_inputs; i++)
+        free(inputs[i]);
+    return new;
+}
+
+// ["text", <text>] -> starts counting the text, it's read right from the frame (the job keeps it)
+static job* start_text(request *req, double priority, char *error, size_t error_len){
+    if(req->amount != req->body + 2){
+        snprintf(error, error_len, "text needs exactly one frame with the text");
+        return NULL;
+    }
+
+    job *new = new_job(req, priority);
+    zmq_msg_move(&new->text, &req->frames[req->body + 1]);
+    size_t len = zmq_msg_size(&new->text);
+
+    // fmemopen doesn't take empty buffers, but an empty file is just as empty
+    new->text_file = len > 0 ? fmemopen(zmq_msg_data(&new->text), len, "r") : tmpfile();
+    if(!new->text_file){
+        fprintf(stderr, "Could not open text of request.\n");
+        exit(1);
+    }
+    new->input = chunker_init(new->text_file, len);
+    return new;
+}
+
+// "<command>" or "<command>:<priority>", returns false if the priority isn't a positive number
+static bool parse_command(zmq_msg_t *frame, char command[COMMAND_LEN], double *priority){
+    memset(command, 0, COMMAND_LEN);
+    size_t len = zmq_msg_size(frame);
+    if(len < COMMAND_LEN)
+        memcpy(command, zmq_msg_data(frame), len);
+
+    *priority = 1;
+    char *colon = strchr(command, ':');
+    if(!colon)
+        return true;
+
+    char *end = NULL;
+    *priority = strtod(colon + 1, &end);
+    *colon = '\0';
+    return end != colon + 1 && *end == '\0' && *priority > 0;
+}
+
+// starts the job of a request or answers it right away (errors, shutdown)
+static void handle_request(job_server *server, request *req){
+    if(req->amount <= req->body){
+        send_error(server->socket, &req->from, "Empty request");
+        return;
+    }
+
+    char command[COMMAND_LEN];
+    double priority = 1;
+    if(!parse_command(&req->frames[req->body], command, &priority)){
+        send_error(server->socket, &req->from, "The priority has to be a positive number (e.g. count:4)");
+        return;
+    }
+
+    if(!strcmp(command, "shutdown")){
+        server->stopping = true;
+        send_reply(server->socket, &req->from, "ok", "", 0);
+        return;
+    }
+    if(server->stopping){
+        send_error(server->socket, &req->from, "The server is shutting down");
+        return;
+    }
+
+    char error[ENDPOINT_LEN] = {0};
+    job *new = NULL;
+    if(!strcmp(command, "count"))
+        new = start_count(server, req, priority, error, sizeof(error));
+    else if(!strcmp(command, "text"))
+        new = start_text(req, priority, error, sizeof(error));
+    else
+        snprintf(error, sizeof(error), "Unknown command (expected count, text or shutdown)");
+
+    if(!new){
+        send_error(server->socket, &req->from, error);
+        return;
+    }
+    add_job(server, new);
+}
+
+// sends the counts of the job to its client
+static void answer_job(job_server *server, job *current){
+    char *result = NULL;
+    size_t result_len = 0;
+    FILE *out = open_memstream(&result, &result_len);
+    if(!out){
+        fprintf(stderr, "Could not allocate result.\n");
+        exit(1);
+    }
+    write_word_counts(current->counts, out);
+    fclose(out);
+    send_reply(server->socket, &current->to, "ok", result, result_len);
+    free(result);
+}
+
+// moves the job on once its phase is done (MAP -> RED -> reply), returns true if the job is finished
+// a job whose phase failed gets an error, the other jobs aren't affected
+static bool advance_job(job_server *server, job *current){
+    if(!scheduler_phase_is_done(&current->phase))
+        return false;
+    if(current->phase.failed){
+        send_error(server->socket, &current->to, "A task of the job failed too often (it might crash the workers)");
+        return true;
+    }
+
+    bool next_phase = false;
+    if(!current->reducing){
+        close_job_input(current);
+        current->reducing = true;
+        next_phase = reduce_tree_init(&current->tree, server->sched, current->map_results, current->counts, &server->options);
+    }
+    else{
+        next_phase = reduce_tree_next_level(&current->tree);
+    }
+    if(next_phase){
+        scheduler_phase_destroy(&current->phase);
+        reduce_tree_phase_init(&current->tree, &current->phase, current->priority);
+        return false;
+    }
+
+    answer_job(server, current);
+    return true;
+}
+
+void job_server_run(scheduler *sched, void *context, const char *endpoint, int amount_of_readers, const count_options *options,
+                    const char *root){
+    assert(sched);
+    assert(context);
+    assert(endpoint);
+    assert(options);
+
+    job_server server = {0};
+    server.amount_of_readers = amount_of_readers;
+    server.sched = sched;
+    server.options = *options;
+    if(root){
+        server.root = realpath(root, NULL);
+        if(!server.root){
+            fprintf(stderr, "Could not open the root directory %s\n", root);
+            exit(1);
+        }
+    }
+    server.socket = zmq_socket(context, ZMQ_ROUTER);
+    if(!server.socket){
+        fprintf(stderr, "Could not create ZMQ socket: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+    int linger = REPLY_LINGER_MS;
+    zmq_setsockopt(server.socket, ZMQ_LINGER, &linger, sizeof(linger));
+    if(zmq_bind(server.socket, endpoint) != 0){
+        fprintf(stderr, "Could not bind %s: %s\n", endpoint, zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    // SIGINT/ SIGTERM end the server like a shutdown request (no SA_RESTART, so the poll is interrupted)
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    fprintf(stderr, "Serving jobs on %s.\n", endpoint);
+    scheduler_phase **phases = NULL;
+    while(true){
+        // finished jobs are answered, the others keep their order (the round robin goes through them in it)
+        size_t kept = 0;
+        for(size_t i=0; i<server.amount_of_jobs; i++){
+            if(advance_job(&server, server.jobs[i]))
+                destroy_job(server.jobs[i]);
+            else
+                server.jobs[kept++] = server.jobs[i];
+        }
+        server.amount_of_jobs = kept;
+
+        if(stop_requested)
+            server.stopping = true;
+        if(server.stopping && server.amount_of_jobs == 0)
+            break;
+
+        // all jobs share the workers, their phases take turns (see scheduler_phase)
+        phases = (scheduler_phase **) realloc(phases, (server.amount_of_jobs + 1) * sizeof(scheduler_phase *));
+        if(!phases){
+            fprintf(stderr, "Could not allocate jobs.\n");
+            exit(1);
+        }
+        for(size_t i=0; i<server.amount_of_jobs; i++)
+            phases[i] = &server.jobs[i]->phase;
+        scheduler_step(sched, phases, server.amount_of_jobs, server.socket);
+
+        request req = {0};
+        while(receive_request(server.socket, &req)){
+            handle_request(&server, &req);
+            request_close(&req);
+        }
+        request_close(&req);
+    }
+
+    free(phases);
+    free(server.root);
+    free(server.jobs);
+    zmq_close(server.socket);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// This header houses the job server of the distributor (--serve <endpoint>)
+// the distributor keeps running and its workers stay connected between the jobs, so a small job doesn't pay for connecting
+// every worker and sending RIP to all of them afterwards
+// clients send their requests to a ROUTER socket (e.g. with a REQ socket), every frame is a string:
+//   ["count", <path>...]   counts files, directories and glob patterns on the machine of the distributor
+//   ["text", <text>]       counts the text itself
+//   ["shutdown"]           stops the server once the running jobs are done, only then the workers get their RIP
+// the reply is ["ok", <result>] (the same "word,frequency" csv the batch mode prints) or ["error", <message>], a job
+// with a task that fails too often gets an error, while the other jobs go on
+// anyone who can reach the endpoint can count (and so read) any file the distributor can read, unless there is a root:
+// then relative paths are relative to it and a request for a file outside of it (also through symlinks or "..") fails
+// any amount of jobs can run at once, they share the workers fairly (see scheduler_phase), a job gets a bigger share
+// with a priority behind its command ("count:4" gets four times as much as "count"), the default priority is 1
+// every job aggregates its own results, so they don't mix
+#include "./scheduler.h"
+#include "./word_count.h"
+
+// serves jobs on the endpoint until a shutdown request (or SIGINT/ SIGTERM) arrives, the workers aren't killed
+// the files of a count request are read by amount_of_readers threads, every job is counted with the options
+// root is the directory the count requests are restricted to (NULL -> no restriction)
+void job_server_run(scheduler *sched, void *context, const char *endpoint, int amount_of_readers, const count_options *options,
+                    const char *root);
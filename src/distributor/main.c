@@ -9,11 +9,31 @@
 #include <stdlib.h>
 #include <sys/types.h>
 #include <pthread.h>
+#include <time.h>
 #include "../lib/encoder.h"
 #include "../lib/linked_list.h"
 #include "../lib/hashmap.h"
-
-#define MSG_LEN 1500
+#include "../lib/word_ids.h"
+#include "./chunker.h"
+#include "./input_files.h"
+#include "./scheduler.h"
+#include "./window.h"
+#include "./word_count.h"
+#include "./job_server.h"
+#include "./chunk_cache.h"
+#include "./count_state.h"
+#include "./result_index.h"
+#include "./query_server.h"
+#include "../worker/worker.h"
+
+// amount of files that are read at once, unless --readers says otherwise
+#define DEFAULT_READERS 4
+// words per window in the continuous mode, unless --top says otherwise
+#define DEFAULT_TOP 10
+// how long the last windows may take to reach the subscribers on exit (ms)
+#define PUBLISH_LINGER_MS 1000
+// disk space (blocks of the segment files) the chunk cache takes at most, unless --cache-size says otherwise
+#define DEFAULT_CACHE_SIZE (1024ULL << 20)
 
 
 static inline void print_int(void *data){
@@ -21,461 +41,489 @@ static inline void print_int(void *data){
     printf("%d ", temp);
 }
 
-// copy pasted this from the std c lib (would be easy to implement tho)
-static inline bool is_alpha(char c){
-    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
 }
 
-typedef struct{
-    char word[MSG_LEN];     //? this isn't memory efficient, but it can't fail any test, where a word is stupidly long
-    int amount;
-}key_value_pair;
-
-// compare function for list_merge_sort function
-bool compare_pairs(void *data1, void *data2){
-    key_value_pair one = *(key_value_pair *) data1;
-    key_value_pair two = *(key_value_pair *) data2;
-    if(one.amount < two.amount)
-        return true;
-    if(one.amount > two.amount)
-        return false;
-    
-    if(one.amount == two.amount){
-        int temp = strcmp(one.word, two.word);
-        if(temp>0)
-            return true;
-        if(temp<0)
-            return false;
-        
-        // this should never trigger
-        fprintf(stderr, "Two words within the linked list match after combining every key,value pair");
-        exit(1);
+// CONTINUOUS MODE
+// the input is counted pane by pane (MAP and RED of everything that arrived within one slide), after every pane the changes
+// of the window's top N are published (or printed if there is no publisher), until the input ends
+static void count_continuously(scheduler *sched, chunker *input, void *publisher, double slide_ms, size_t panes_per_window, size_t top,
+                               const count_options *options){
+    word_window *window = window_init(panes_per_window, top);
+    double pane_end = now_ms();
+    bool ended = false;
+    while(!ended){
+        // a pane that took longer than a slide doesn't make the next ones shorter
+        pane_end += slide_ms;
+        if(pane_end < now_ms())
+            pane_end = now_ms() + slide_ms;
+        chunker_set_deadline(input, pane_end);
+
+        // a pane whose task failed too often still goes into the window, the windows are just missing some counts then
+        hashmap *pane = word_counts_init();
+        if(count_words(sched, input, pane, options) != 0)
+            fprintf(stderr, "A task failed too often, the counts of this pane are incomplete.\n");
+
+        // the input ended before the pane was over -> this is the last one
+        chunker_set_deadline(input, 0);
+        ended = chunker_is_finished(input);
+
+        window_add_pane(window, pane);
+        char *changes = window_top_changes(window);
+        if(publisher){
+            if(zmq_send(publisher, changes, strlen(changes), 0) < 0)
+                fprintf(stderr, "Could not publish window: %s\n", zmq_strerror(zmq_errno()));
+        }
+        else{
+            fputs(changes, stdout);
+            fflush(stdout);
+        }
+        free(changes);
     }
-
-    // just because of ICO C standards (-Wreturn-type)
-    // in reality, this will never be reached
-    return false;
+    window_destroy(window);
 }
 
-// this is very ugly but it kinda works
-static list_head *result;
 
-// helper func for hashmap_to_linked_list
-void handle_each_hashmap_element(void *key, void *value){
-    key_value_pair pair;
-    strcpy(pair.word, (char*)key);
-    pair.amount = *(int*)value;
+// parses an optional ":weight" at the end of the string and cuts it off
+// returns 0 on success (also if there is no weight)
+static int parse_weight(char *str, double *weight){
+    *weight = 1;
+    char *colon = strrchr(str, ':');
+    if(!colon)
+        return 0;
 
-    assert(result);
-    list_insert_back(result, &pair);
-}
+    char *end = NULL;
+    double value = strtod(colon + 1, &end);
+    if(end == colon + 1 || *end != '\0')
+        return 0;       // not a number -> part of the endpoint
+    if(!(value > 0))
+        return 1;
 
-// wrapper func
-void hashmap_to_linked_list(hashmap *map){
-    result = list_init(sizeof(key_value_pair));
-    hashmap_remove_all_elements(map, handle_each_hashmap_element);
+    *weight = value;
+    *colon = '\0';
+    return 0;
 }
 
-// load balancing function
-// copies the file in chunks [type: char*] to the supplied linked list
-// returns -1 on failure, 0 on success
-// this func assumes the file is open with read privileges
-int assign_next_file_chunk_to_list(list_head *list, FILE *fp, unsigned long long file_size){
-    if(!list || !fp)
-        return -1;
-    
-    if(file_size == 0){
-        char temp[MSG_LEN-3] = {0};
-        list_insert_back(list, temp);
-        return 0;
+// parses "host:port" (IPv6 hosts in brackets, e.g. "[::1]:5555") and writes the tcp endpoint
+// a missing host means localhost, returns 0 on success
+static int parse_tcp_address(const char *address, worker_spec *spec){
+    char host[ENDPOINT_LEN] = "localhost";
+    const char *port = address;
+
+    const char *colon = NULL;
+    if(address[0] == '['){
+        const char *bracket = strchr(address, ']');
+        if(!bracket || bracket[1] != ':')
+            return 1;
+        colon = bracket + 1;
+    }
+    else{
+        colon = strrchr(address, ':');
     }
 
-    unsigned long long current_offset = 0;       // keeps track of last assigned chunk
-
-    jumpback_label: ;       // this isn't pretty, but it is in case there is a chunk of chunk_size (MSG_LEN-4 bytes) inside the file, where no word can be found
-
-    while(true){
-        char chunk[MSG_LEN-3] = {0};
-        // no more chunks left
-        if(current_offset >= file_size)
-            return 0;
-    
-        // MSG_LEN-4 because the first 3 bytes are reserved for command and one is needed for NUL string terminator
-        size_t chunk_size = MSG_LEN - 4;
+    if(colon){
+        size_t host_len = (size_t)(colon - address);
+        if(host_len == 0 || host_len >= sizeof(host))
+            return 1;
+        memcpy(host, address, host_len);
+        host[host_len] = '\0';
+        port = colon + 1;
+    }
 
-        // check if this is the last chunk
-        if(current_offset + chunk_size >= file_size){
-            chunk_size = file_size - current_offset;
-        }
+    char *end = NULL;
+    long port_nr = strtol(port, &end, 10);
+    if(end == port || *end != '\0' || port_nr <= 0 || port_nr > 65535)
+        return 1;
 
-        // assert no word splitting
-        // preventing possibility of it splitting the chunk in a wrong way. a sequence inside the file, which could look like this:
-        // "word1111another11" must be kept intact and cannot be split into "word111" and "1another11"
-        size_t temp = chunk_size;
-        if(current_offset + chunk_size < file_size){            // rest of file is too big for chunk
-            fseek(fp, temp-1, SEEK_CUR);                        // move to end of chunk
-            char c = fgetc(fp);
-            while(c != EOF && !is_alpha(c)){                     // landed on a non char -> need to move to previous word
-                temp--;
-                if(temp == 0){  // cannot find a word in chunk
-                    fprintf(stderr, "Could not find word in chunk. Skipping chunk.");
-                    current_offset += chunk_size;
-                    goto jumpback_label;
-                }
-
-                fseek(fp, -2, SEEK_CUR);            // -2 because fgetc moved one forward so we have to compensate
-                c = fgetc(fp);
-            }
+    strcpy(spec->host, host);
+    if(snprintf(spec->endpoint, sizeof(spec->endpoint), "tcp://%s:%ld", host, port_nr) >= (int) sizeof(spec->endpoint))
+        return 1;
+    return 0;
+}
 
-            while(c != EOF && is_alpha(c)){                     // now on a char (landed or moved back) -> need to move to next non word
-                temp--;
-                if(temp == 0)   // cannot find the ending of a word in chunk -> no valid chunk selection possible
-                    return 0;
+// parses a worker as given on the command line, the weight is always optional (default 1):
+//   "5555" or "5555:4"                     -> tcp://localhost:5555
+//   "node2:5555" or "node2:5555:4"         -> tcp://node2:5555
+//   "tcp://node2:5555:4"                   -> tcp://node2:5555
+//   "ipc:///tmp/worker0:4", "inproc://worker0" -> as is (these run on the same machine as the distributor)
+//   "shm://worker0:4"                      -> as is (shared memory, see shm_ring.h)
+// returns 0 on success
+static int parse_worker_spec(const char *arg, worker_spec *spec){
+    char buffer[ENDPOINT_LEN] = {0};
+    if(strlen(arg) >= sizeof(buffer))
+        return 1;
+    strcpy(buffer, arg);
+
+    if(!strncmp(buffer, "ipc://", 6) || !strncmp(buffer, "inproc://", 9) || !strncmp(buffer, "shm://", 6)){
+        if(parse_weight(buffer, &spec->weight) != 0)
+            return 1;
+        strcpy(spec->endpoint, buffer);
+        strcpy(spec->host, "localhost");
+        return 0;
+    }
 
-                fseek(fp, -2, SEEK_CUR);            // -2 because fgetc moved one forward so we have to compensate
-                c = fgetc(fp);
-            }
-        }
+    char *address = buffer;
+    if(!strncmp(address, "tcp://", 6))
+        address += 6;
+    else if(strstr(address, "://"))
+        return 1;       // unsupported transport
+
+    // "5555:4" and "node2:5555" look alike, a host is never just a number though
+    size_t digits = strspn(address, "0123456789");
+    bool port_only = digits > 0 && (address[digits] == '\0' || address[digits] == ':');
+
+    // the weight is the part after the second colon ("node2:5555:4") or the first one ("5555:4")
+    // IPv6 addresses need brackets, so the colons within them don't count
+    const char *after_host = address[0] == '[' ? strchr(address, ']') : address;
+    const char *colon = after_host ? strchr(after_host, ':') : NULL;
+    if(port_only || (colon && strchr(colon + 1, ':'))){
+        if(parse_weight(address, &spec->weight) != 0)
+            return 1;
+    }
+    else{
+        spec->weight = 1;
+    }
 
-        // copy chunk to buffer
-        fseek(fp, current_offset, SEEK_SET);    // move to start of chunk
-        if(fread(chunk, 1, temp, fp) != temp){
-            return 0;
-        }
+    return parse_tcp_address(address, spec);
+}
 
-        if(temp == MSG_LEN - 4)                 // chunk len is maximum
-            chunk[MSG_LEN-3] = '\0';
-        else
-            chunk[temp] = '\0';
+// kills all workers with RIP (and waits for the local ones), then everything else is cleaned up
+static void shut_down(scheduler *sched, void *context, pthread_t local_workers[], int amount_of_local_workers){
+    scheduler_kill_workers(sched);
+    for(int i=0; i<amount_of_local_workers; i++)
+        pthread_join(local_workers[i], NULL);
 
-        current_offset += temp;
-        list_insert_back(list, chunk);
+    if(sched->cache){
+        chunk_cache_print_stats(sched->cache);
+        chunk_cache_close(sched->cache);
     }
-}
-
-void print_result_to_stdout(){
-    printf("word,frequency\n");
-    while(!list_is_empty(result)){
-        key_value_pair pair;
-        list_remove_back(result, &pair);
-        if(pair.word[0] == '\0')
-            continue;
-        printf("%s,%d\n", pair.word, pair.amount);
+    if(sched->dictionary){
+        fprintf(stderr, "%zu words got an ID.\n", sched->dictionary->amount);
+        word_dictionary_destroy(sched->dictionary);
     }
+    scheduler_destroy(sched);
+    zmq_ctx_destroy(context);
 }
 
-
-typedef struct{
-    void *context;
-    int port;
-    MSG_TYPE command;
-    char chunk[MSG_LEN];
-}worker_data;
-
-void print_job(void *data){
-    char *temp = (char *)data;
-    printf("%s\n\n",temp);
+// answers queries about the result until the service is stopped (see query_server.h), the index is closed afterwards
+static void serve_queries(result_index *index, const char *endpoint){
+    void *context = zmq_ctx_new();
+    query_server_run(index, context, endpoint);
+    result_index_close(index);
+    zmq_ctx_destroy(context);
 }
 
-void *handle_worker_thread(void *data){
-    assert(data);
-    worker_data *worker = (worker_data *) data;
-    assert(worker->context);
-    assert(worker->port > 0);
-
-    void *distributor = zmq_socket(worker->context, ZMQ_REQ);
-    if(!distributor){
-        fprintf(stderr, "Could not create ZMQ socker: %s\n", zmq_strerror(zmq_errno()));
-        pthread_exit(NULL);
+int main(int argc, char **argv){
+    // options come before the file: --listen <endpoint> lets workers connect and register themselves
+    // --local <n> runs n workers as threads of the distributor (inproc://, no worker process needed)
+    // --input <path> adds another input (file, directory or glob pattern, so is the file itself), --readers <n> reads n files at once
+    // the file "-" is stdin (zcat corpus.gz | zmq_distributor - 5555), it can't be combined with other inputs
+    // --window <s> counts continuously in windows of s seconds, that move by --slide <s> (default: the window, so they don't overlap)
+    // every window publishes the changes of its --top <n> words on the --publish <endpoint> (PUB socket, stdout if there is none)
+    // --serve <endpoint> keeps the distributor running as a job server (see job_server.h), then there is no file, just workers
+    // --root <dir> restricts the count requests of the job server to the files within dir
+    // --cache <dir> keeps the MAP results of the chunks in dir (at most --cache-size <MiB> of disk space), unchanged chunks aren't mapped again
+    // --state <file> saves the counts after the run, the next run only counts what has been appended to the files since
+    // --index <file> writes the counts to a binary file as well (see result_index.h), that can be mapped to look words up
+    // --query <endpoint> answers lookups of the result once it's done (see query_server.h), without a file the one of --index
+    // --dictionary gives the frequent words IDs, the MAP and RED results carry those instead of the words (see word_ids.h)
+    // --tree <n> lets the workers merge the RED results level by level until at most n tables are left (see reduce_tree.h)
+    // --combine lets MAP send every word of a chunk once with its count instead of a 1 per occurrence
+    // --timeout <ms> is how long a worker may take for a task before it's handed to another one
+    const char *listen_endpoint = NULL;
+    const char *cache_dir = NULL;
+    const char *state_path = NULL;
+    const char *index_path = NULL;
+    const char *query_endpoint = NULL;
+    bool use_dictionary = false;
+    count_options options = {0};
+    double request_timeout = DEFAULT_REQUEST_TIMEOUT_MS;
+    unsigned long long cache_size = DEFAULT_CACHE_SIZE;
+    const char *serve_endpoint = NULL;
+    const char *root = NULL;
+    const char *publish_endpoint = NULL;
+    double window_seconds = 0;
+    double slide_seconds = 0;
+    size_t top = DEFAULT_TOP;
+    int amount_of_local_workers = 0;
+    int amount_of_readers = DEFAULT_READERS;
+    char *inputs[argc];
+    size_t amount_of_inputs = 0;
+    int arg = 1;
+    while(arg < argc && !strncmp(argv[arg], "--", 2)){
+        if(!strcmp(argv[arg], "--input") && arg+1 < argc){
+            inputs[amount_of_inputs++] = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--readers") && arg+1 < argc && atoi(argv[arg+1]) > 0){
+            amount_of_readers = atoi(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--window") && arg+1 < argc && atof(argv[arg+1]) > 0){
+            window_seconds = atof(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--slide") && arg+1 < argc && atof(argv[arg+1]) > 0){
+            slide_seconds = atof(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--top") && arg+1 < argc && atoi(argv[arg+1]) > 0){
+            top = (size_t) atoi(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--publish") && arg+1 < argc){
+            publish_endpoint = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--serve") && arg+1 < argc){
+            serve_endpoint = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--root") && arg+1 < argc){
+            root = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--cache") && arg+1 < argc){
+            cache_dir = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--cache-size") && arg+1 < argc && atoll(argv[arg+1]) > 0){
+            cache_size = (unsigned long long) atoll(argv[arg+1]) << 20;
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--state") && arg+1 < argc){
+            state_path = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--index") && arg+1 < argc){
+            index_path = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--query") && arg+1 < argc){
+            query_endpoint = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--dictionary")){
+            use_dictionary = true;
+            arg++;
+        }
+        else if(!strcmp(argv[arg], "--tree") && arg+1 < argc && atoi(argv[arg+1]) > 0){
+            options.fan_in = (size_t) atoi(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--combine")){
+            options.combine = true;
+            arg++;
+        }
+        else if(!strcmp(argv[arg], "--timeout") && arg+1 < argc && atof(argv[arg+1]) > 0){
+            request_timeout = atof(argv[arg+1]);
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--listen") && arg+1 < argc){
+            listen_endpoint = argv[arg+1];
+            arg += 2;
+        }
+        else if(!strcmp(argv[arg], "--local") && arg+1 < argc && atoi(argv[arg+1]) > 0){
+            amount_of_local_workers = atoi(argv[arg+1]);
+            arg += 2;
+        }
+        else{
+            fprintf(stderr, "Unknown option: %s\n", argv[arg]);
+            exit(1);
+        }
     }
 
-    // convert port number to string and copy to buffer
-    char port_buff[30] = {0};
-    if(snprintf(port_buff, sizeof(port_buff), "tcp://localhost:%d", worker->port) < 0){
-        fprintf(stderr, "Port number could not be copied.\n");
-        pthread_exit(NULL);
+    if(query_endpoint && (serve_endpoint || window_seconds > 0)){
+        fprintf(stderr, "--query needs a final result, it can't be combined with --serve or --window\n");
+        exit(1);
     }
 
-    // connect to port
-    int rc = zmq_connect(distributor, port_buff);
-    if(rc != 0){
-        fprintf(stderr, "Could not connect to port %d (ZMQ error): %s\n", worker->port, zmq_strerror(zmq_errno()));
-        fprintf(stderr, "Command: %d\n", worker->command);
-        zmq_close(distributor);
-        pthread_exit(NULL);
+    if(use_dictionary && cache_dir){
+        fprintf(stderr, "--dictionary can't be combined with --cache, the cache holds plain MAP results\n");
+        exit(1);
     }
-
-    // handle worker
-    char buffer[MSG_LEN] = {0};
-    if(encode_msg_to_worker(buffer, worker->chunk, worker->command) != 0){
-        fprintf(stderr, "Could not encode message.\n\n");
-        pthread_exit(NULL);
+    if(options.combine && cache_dir){
+        fprintf(stderr, "--combine can't be used with --cache, the cache holds plain MAP results\n");
+        exit(1);
     }
 
-    zmq_send(distributor, buffer, strlen(buffer)+1, 0);
-
-    memset(buffer, 0, sizeof(buffer));
-    memset(worker->chunk, 0, sizeof(worker->chunk));
-    zmq_recv(distributor, buffer, MSG_LEN, 0);
-    worker->command = decode_msg_from_worker(buffer, worker->chunk);
-
-    zmq_close(distributor);
-    return worker;
-    pthread_exit(NULL);
-}
-
+    // QUERY SERVICE of an earlier result, there is nothing to count and no worker is needed
+    if(query_endpoint && arg == argc && amount_of_inputs == 0){
+        result_index *index = index_path ? result_index_open(index_path) : NULL;
+        if(!index){
+            fprintf(stderr, "--query without a file needs the --index of an earlier run\n");
+            exit(1);
+        }
+        serve_queries(index, query_endpoint);
+        return 0;
+    }
 
-int main(int argc, char **argv){
-    unsigned int amount_of_ports = 0;
-    if(argc<=2){
+    // without --listen or --local at least one worker has to be given (and a file, unless the jobs come from clients)
+    if(argc - arg < (listen_endpoint || amount_of_local_workers ? 0 : 1) + (serve_endpoint ? 0 : 1)){
         fprintf(stderr, "Not enough arguments: %d", argc);
         exit(1);
     }
-    
-    amount_of_ports = (unsigned int) argc - 2;     // subtract 2 because program name and file name are the first two parameters
-    assert(amount_of_ports>0);
-
-    // parse all port numbers
-    int ports[(const unsigned int)amount_of_ports];
-    for(unsigned int i=0; i<amount_of_ports; i++){
-        ports[i] = atoi(argv[i+2]);
+    if(serve_endpoint && (amount_of_inputs > 0 || window_seconds > 0 || state_path || index_path)){
+        fprintf(stderr, "--serve gets its inputs from the clients, it can't be combined with --input, --window, --state or --index\n");
+        exit(1);
     }
-
-    // open file
-    FILE *fp;
-    fp = fopen(argv[1], "r");
-    if(fp == NULL){
-        fprintf(stderr, "Could not open file\n");
+    if(root && !serve_endpoint){
+        fprintf(stderr, "--root restricts the requests of the job server, it needs --serve\n");
         exit(1);
     }
-
-    fseek(fp, 0L, SEEK_END);
-    unsigned long long file_size = ftell(fp);   // size of file in bytes
-    rewind(fp);
-   
-    // worker handling bs begins here
-    void *context = zmq_ctx_new();
-    pthread_t worker_handlers[(const unsigned int)amount_of_ports];
-
-    // I am using two linked list to queue tasks (one for the jobs themselves and one for the workers, that aren't busy atm)
-    // I also need one to check which tasks we need to join next
-    list_head *workers_waiting_queue = list_init(sizeof(int));
-    list_head *workers_running_queue = list_init(sizeof(int));
-    list_head *task_queue = list_init(sizeof(char) * (MSG_LEN-3));
-
-
-    // MAP SECTION
-    // queue all MAP tasks
-    if(assign_next_file_chunk_to_list(task_queue, fp, file_size)){
-        fprintf(stderr, "Assigning tasks went wrong.\n");
+    if(!serve_endpoint)
+        inputs[amount_of_inputs++] = argv[arg++];
+
+    // a sliding window consists of whole slides (panes)
+    if(slide_seconds == 0)
+        slide_seconds = window_seconds;
+    if(window_seconds > 0 && slide_seconds > window_seconds){
+        fprintf(stderr, "The slide can't be longer than the window\n");
         exit(1);
     }
-    fclose(fp); // file no longer needed
-
-    // todo: remove print statements
-    //printf("\n\n\nMAP JOBS:\n");
-    //list_print(task_queue, print_job);
-
-    for(unsigned int i=0; i<amount_of_ports; i++){
-        list_insert_back(workers_waiting_queue, &i);            // saves the index of the worker in the queue -> pthread_t worker_handlers and int ports and be accessed this way
+    // the window has to be a whole number of slides, rounding would silently change its length
+    size_t panes_per_window = window_seconds > 0 ? (size_t)(window_seconds / slide_seconds + 0.5) : 1;
+    double rest = panes_per_window * slide_seconds - window_seconds;
+    if(window_seconds > 0 && (rest > 1e-9 * window_seconds || rest < -1e-9 * window_seconds)){
+        fprintf(stderr, "The window (%gs) has to be a multiple of the slide (%gs)\n", window_seconds, slide_seconds);
+        exit(1);
+    }
+    if(index_path && window_seconds > 0){
+        fprintf(stderr, "--index needs a final result, it can't be combined with --window\n");
+        exit(1);
     }
-    
-    // temp file for result of map
-    FILE *map_temp_file = fopen("map_results.txt", "w+");
-    if(map_temp_file == NULL){
-        fprintf(stderr, "Failed to create temporary file for MAP results with write privileges.\n");
+    if((publish_endpoint || slide_seconds > 0) && window_seconds == 0){
+        fprintf(stderr, "--slide and --publish need --window\n");
         exit(1);
     }
 
-    // running MAP
-    while(!list_is_empty(task_queue) || !list_is_empty(workers_running_queue)){
-        if(!list_is_empty(workers_waiting_queue) && !list_is_empty(task_queue)){
-            int worker_nr = -1;
-            list_remove_front(workers_waiting_queue, &worker_nr);
+    unsigned int amount_of_ports = (unsigned int)(argc - arg);     // everything behind the file name is a worker
 
-            worker_data *temp = (worker_data *) calloc(1, sizeof(worker_data));
-            if(!temp){
-                fprintf(stderr, "Could not allocate worker data as thread argument.\n");
-                exit(1);
-            }
-
-            assert(worker_nr != -1);
-            
-            list_remove_front(task_queue, temp->chunk);
-            temp->port = ports[worker_nr];
-            temp->command = MAP;
-            temp->context = context;
-            pthread_create((pthread_t *)&worker_handlers[worker_nr], NULL, handle_worker_thread, (void *)temp);
-            list_insert_back(workers_running_queue, &worker_nr);
-        }
-        else{       // this could be optimized by using a thread pool instead of creating and destroying threads
-            int worker_index = -1;
-            list_remove_front(workers_running_queue, &worker_index);
-            assert(worker_index != -1);
-
-            worker_data *temp = NULL;
-            int res = pthread_join((pthread_t)worker_handlers[worker_index], (void **)&temp);
-                
-            assert(temp);
-            assert(res == 0);
-
-            fprintf(map_temp_file, "%s", temp->chunk);        // save map output to map_temp_file
-            list_insert_back(workers_waiting_queue, &worker_index);
-            free(temp);
+    // parse all workers (ports or endpoints and weights), the local ones come last
+    worker_spec workers[(const unsigned int)(amount_of_ports + amount_of_local_workers) + 1];    // + 1, VLAs of size 0 are UB
+    for(unsigned int i=0; i<amount_of_ports; i++){
+        if(parse_worker_spec(argv[arg+i], &workers[i]) != 0){
+            fprintf(stderr, "Invalid worker: %s (expected [host:]port[:weight] or an ipc://, inproc:// or shm:// endpoint)\n", argv[arg+i]);
+            exit(1);
         }
     }
-    assert(list_is_empty(workers_running_queue));
-    fclose(map_temp_file);
 
-
-    // RED SECTION
-    map_temp_file = fopen("map_results.txt", "r");
-    if (!map_temp_file) {
-        fprintf(stderr, "Failed to open temporary file of MAP results with read privileges.\n");
+    // find all files (exits if one can't be opened)
+    bool from_stdin = false;
+    for(size_t i=0; i<amount_of_inputs; i++){
+        if(!strcmp(inputs[i], "-"))
+            from_stdin = true;
+    }
+    if(from_stdin && amount_of_inputs > 1){
+        fprintf(stderr, "stdin (-) can't be combined with other inputs\n");
         exit(1);
     }
-
-    fseek(map_temp_file, 0L, SEEK_END);
-    file_size = ftell(map_temp_file);   // size of file in bytes
-    rewind(map_temp_file);
-
-    if(assign_next_file_chunk_to_list(task_queue, map_temp_file, file_size)){
-        fprintf(stderr, "Assigning tasks went wrong\n.");
+    if(state_path && (from_stdin || window_seconds > 0)){
+        fprintf(stderr, "--state needs files, it can't be combined with stdin (-) or --window\n");
         exit(1);
     }
-    fclose(map_temp_file);
-    // todo: uncomment remove call
-    remove("map_results.txt");      // cleanup
-
-    // todo: remove print calls
-    //printf("\n\n\nRED JOBS:\n");
-    //list_print(task_queue, print_job);
-
-    hashmap *map = hashmap_init(50, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
-    while(!list_is_empty(task_queue) || !list_is_empty(workers_running_queue)){
-        if(!list_is_empty(workers_waiting_queue) && !list_is_empty(task_queue)){
-            int worker_nr = -1;
-            list_remove_front(workers_waiting_queue, &worker_nr);
-            worker_data *temp = (worker_data *) calloc(1, sizeof(worker_data));
-            if(!temp){
-                printf("Could not allocate worker data as thread argument.\n");
-                exit(1);
-            }
-            assert(worker_nr != -1);
-
-            list_remove_front(task_queue, (void *)temp->chunk);
-            temp->port = ports[worker_nr];
-            temp->command = RED;
-            temp->context = context;
-            pthread_create((pthread_t *)&worker_handlers[worker_nr], NULL, handle_worker_thread, (void *)temp);
-            list_insert_back(workers_running_queue, &worker_nr);
-        }
-        // list is empty
-        else{       // this could be optimized by sleeping and getting an interrupt on worker thread exit
-            int worker_index = -1;
-            list_remove_front(workers_running_queue, &worker_index);
-            assert(worker_index != -1);
-
-            worker_data *temp = NULL;
-            int res = pthread_join((pthread_t)worker_handlers[worker_index], (void **)&temp);
-
-            if(!temp || res != 0){
-                fprintf(stderr, "Joined Thread %d running on Port %d returned NULL instead of valid worker_data pointer.\n", worker_index, ports[worker_index]);
-                fprintf(stderr, "pthread_join returned %d\n", res);
-                exit(1);
-            }
-
-            // add data from workers to hashmap
-            key_value_pair pair;
-            pair.amount = 0;
-            pair.word[0] = '\0';
-            int word_end = 0;
-            int value_end = 0;
-            char value_as_string[10] = {0};  // 10 digits should be enough (if not, the one who made the testbench is smoking some good stuff)
-            for(int j=0; temp->chunk[j] != '\0'; j++){
-                if(is_alpha(temp->chunk[j])){
-                    if(value_end > 0){
-                        // new word begins -> add last word and number to hashmap
-                        value_as_string[value_end] = '\0';
-                        value_end = 0;
-
-                        pair.amount = atoi(value_as_string);
-                        int word_count = pair.amount;
-                        if(hashmap_contains(map, pair.word)){
-                            hashmap_get(map, pair.word, &word_count);
-                            word_count += pair.amount;
-                        }
-                        
-                        hashmap_put(map, pair.word, &word_count);
-                    }
-
-                    pair.word[word_end] = temp->chunk[j];
-                    word_end++;
-                }
-                else{   // is a number
-                    if(word_end > 0){
-                        pair.word[word_end] = '\0';
-                        word_end = 0;
-                    }
-                    value_as_string[value_end] = temp->chunk[j];
-                    value_end++;
-                }
-            }
-
-            // add last pair
-            value_as_string[value_end] = '\0';
-            value_end = 0;
+    input_files *files = from_stdin || serve_endpoint ? NULL : input_files_expand(inputs, amount_of_inputs);
 
+    // what has been counted in the last run is skipped, its counts are where this one starts
+    hashmap *map = word_counts_init();
+    if(state_path)
+        count_state_resume(state_path, files, map);
+   
+    // worker handling bs begins here
+    void *context = zmq_ctx_new();
 
-            pair.amount = atoi(value_as_string);
-            int word_count = pair.amount;
-            if(hashmap_contains(map, pair.word)){
-                hashmap_get(map, pair.word, &word_count);
-                word_count += pair.amount;
-            }
-            hashmap_put(map, pair.word, &word_count);
-                
-            // add worker back to queue
-            list_insert_back(workers_waiting_queue, &worker_index);
+    // local workers share the context, inproc:// only works within one
+    pthread_t local_workers[amount_of_local_workers + 1];
+    worker_data local_worker_arguments[amount_of_local_workers + 1];
+    for(int i=0; i<amount_of_local_workers; i++){
+        worker_spec *spec = &workers[amount_of_ports + i];
+        snprintf(spec->endpoint, ENDPOINT_LEN, "inproc://local-worker%d", i);
+        strcpy(spec->host, "localhost");
+        spec->weight = 1;
+
+        local_worker_arguments[i].context = context;
+        strcpy(local_worker_arguments[i].endpoint, spec->endpoint);
+        pthread_create(&local_workers[i], NULL, worker_thread, &local_worker_arguments[i]);
+    }
 
-            free(temp);
-        }
+    // the scheduler keeps track of the workers, that aren't busy atm, and the tasks that are still running
+    scheduler *sched = scheduler_init(context, workers, amount_of_ports + amount_of_local_workers, listen_endpoint);
+    sched->request_timeout = request_timeout;
+    if(cache_dir)
+        sched->cache = chunk_cache_open(cache_dir, cache_size);
+    if(use_dictionary)
+        sched->dictionary = word_dictionary_init();
+
+    // JOB SERVER
+    // the workers stay connected from one job to the next, they only get their RIP once the server is shut down
+    if(serve_endpoint){
+        job_server_run(sched, context, serve_endpoint, amount_of_readers, &options, root);
+        hashmap_destroy(map);
+
+        shut_down(sched, context, local_workers, amount_of_local_workers);
+        return 0;
     }
 
-    
-    // kill all workers with RIP
-    for(unsigned int i=0; i<amount_of_ports; i++){
-        worker_data *temp = (worker_data *) calloc(1, sizeof(worker_data));
-        if(!temp){
-            printf("Could not allocate worker data as thread argument.\n");
-            exit(1);
+    // MAP SECTION
+    // the tasks are cut from the files while they are handed out, the readers load the next files in the meantime
+    chunker *input = from_stdin ? chunker_init_stream(STDIN_FILENO) : chunker_init_files(files, amount_of_readers);
+
+    if(window_seconds > 0){
+        void *publisher = NULL;
+        if(publish_endpoint){
+            publisher = zmq_socket(context, ZMQ_PUB);
+            int linger = PUBLISH_LINGER_MS;
+            zmq_setsockopt(publisher, ZMQ_LINGER, &linger, sizeof(linger));
+            if(zmq_bind(publisher, publish_endpoint) != 0){
+                fprintf(stderr, "Could not bind %s: %s\n", publish_endpoint, zmq_strerror(zmq_errno()));
+                exit(1);
+            }
         }
-        temp->port = ports[i];
-        temp->chunk[0] = '\0';
-        temp->context = context;
-        temp->command = RIP;
-        pthread_create((pthread_t *)&worker_handlers[i], NULL, handle_worker_thread, (void *)temp);
+        count_continuously(sched, input, publisher, slide_seconds * 1000, panes_per_window, top, &options);
+        chunker_destroy(input);
+        if(files)
+            input_files_destroy(files);
+        if(publisher)
+            zmq_close(publisher);
+        hashmap_destroy(map);
+
+        shut_down(sched, context, local_workers, amount_of_local_workers);
+        return 0;
     }
 
-    for(unsigned int i=0; i<amount_of_ports; i++){
-        worker_data *temp = NULL;
-        pthread_join((pthread_t)worker_handlers[i], (void **)&temp);
-        free(temp);
+    // running MAP and RED, there is no result if a task failed too often
+    if(count_words(sched, input, map, &options) != 0){
+        fprintf(stderr, "A task failed too often, the count is incomplete.\n");
+        chunker_destroy(input);
+        if(files)
+            input_files_destroy(files);
+        hashmap_destroy(map);
+        shut_down(sched, context, local_workers, amount_of_local_workers);
+        return 1;
     }
+    chunker_destroy(input);
+    if(state_path)
+        count_state_save(state_path, files, map);
+    if(files)
+        input_files_destroy(files);     // files no longer needed
 
-    // cleanup
-    list_destroy(workers_running_queue);
-    list_destroy(workers_waiting_queue);
-    list_destroy(task_queue);
-    zmq_ctx_destroy(context);
+    // kill all workers with RIP and cleanup
+    shut_down(sched, context, local_workers, amount_of_local_workers);
 
     // generate output
-    hashmap_to_linked_list(map);
-    list_merge_sort(result, compare_pairs);
-    print_result_to_stdout();
+    write_word_counts(map, stdout);
+    if(index_path)
+        result_index_write(map, index_path);
 
-    // more cleanup
-    list_destroy(result);
+    // the hashmap is done once the index has been built, the queries only need the index
+    result_index *index = query_endpoint ? (index_path ? result_index_open(index_path) : result_index_from_counts(map)) : NULL;
     hashmap_destroy(map);
+    if(index){
+        fflush(stdout);
+        serve_queries(index, query_endpoint);
+    }
     return 0;
 }
@@ -0,0 +1,233 @@
+#include <zmq.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <errno.h>
+#include <assert.h>
+#include "../lib/encoder.h"
+#include "./query_server.h"
+
+// words a prefix query returns, unless it says otherwise
+#define DEFAULT_PREFIX_LIMIT 100
+// how long the last reply may take to reach its client on shutdown (ms)
+#define REPLY_LINGER_MS 1000
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int signal_nr){
+    (void) signal_nr;
+    stop_requested = 1;
+}
+
+// the reply to one query, the buffer is reused for all of them
+typedef struct{
+    char *data;
+    size_t len;
+    size_t capacity;
+}reply_buffer;
+
+typedef struct{
+    zmq_msg_t *frames;
+    size_t amount;
+    size_t capacity;
+}query_list;
+
+static inline char to_lower(char c){
+    return c>='A' && c<='Z' ? c - 'A' + 'a' : c;
+}
+
+static void append(reply_buffer *reply, const char *data, size_t len){
+    if(reply->len + len > reply->capacity){
+        while(reply->len + len > reply->capacity)
+            reply->capacity = reply->capacity ? reply->capacity * 2 : 4096;
+        reply->data = (char *) realloc(reply->data, reply->capacity);
+        if(!reply->data){
+            fprintf(stderr, "Could not allocate reply.\n");
+            exit(1);
+        }
+    }
+    memcpy(&reply->data[reply->len], data, len);
+    reply->len += len;
+}
+
+static void append_string(reply_buffer *reply, const char *str){
+    append(reply, str, strlen(str));
+}
+
+// "word,count\n"
+static void append_word(reply_buffer *reply, result_index *index, uint64_t nr){
+    size_t len;
+    const char *word = result_index_word(index, nr, &len);
+    char count[32];
+    int count_len = snprintf(count, sizeof(count), ",%llu\n", (unsigned long long) result_index_count(index, nr));
+    append(reply, word, len);
+    append(reply, count, (size_t) count_len);
+}
+
+// the word in lowercase and NUL terminated, returns false if it's too long to have been counted
+static bool lowercase(const char *word, size_t len, char buffer[MSG_LEN]){
+    if(len >= MSG_LEN)
+        return false;
+    for(size_t i=0; i<len; i++)
+        buffer[i] = to_lower(word[i]);
+    buffer[len] = '\0';
+    return true;
+}
+
+// parses a number that makes up all of str, returns false if it isn't one
+static bool parse_number(const char *str, size_t len, unsigned long long *value){
+    char buffer[32];
+    if(len == 0 || len >= sizeof(buffer))
+        return false;
+    memcpy(buffer, str, len);
+    buffer[len] = '\0';
+    if(strspn(buffer, "0123456789") < len)
+        return false;
+    *value = strtoull(buffer, NULL, 10);
+    return true;
+}
+
+// answers one query into the reply, returns true if it asks the service to stop
+static bool answer(result_index *index, const char *query, size_t len, reply_buffer *reply){
+    reply->len = 0;
+    const char *space = (const char *) memchr(query, ' ', len);
+    size_t command_len = space ? (size_t)(space - query) : len;
+    const char *arg = space ? space + 1 : &query[len];
+    size_t arg_len = (size_t)(&query[len] - arg);
+    uint64_t amount_of_words = index->header->amount_of_words;
+    char word[MSG_LEN];
+
+    if(command_len == 3 && !memcmp(query, "get", 3) && arg_len > 0){
+        int64_t nr = lowercase(arg, arg_len, word) ? result_index_find(index, word, arg_len) : -1;
+        char count[32];
+        snprintf(count, sizeof(count), "%llu", nr < 0 ? 0ULL : (unsigned long long) result_index_count(index, (uint64_t) nr));
+        append_string(reply, count);
+        return false;
+    }
+
+    if(command_len == 6 && !memcmp(query, "prefix", 6)){
+        // "prefix <prefix> [<limit>]", an empty prefix lists all words
+        const char *limit_start = (const char *) memchr(arg, ' ', arg_len);
+        size_t prefix_len = limit_start ? (size_t)(limit_start - arg) : arg_len;
+        unsigned long long limit = DEFAULT_PREFIX_LIMIT;
+        if(limit_start && !parse_number(limit_start + 1, (size_t)(&arg[arg_len] - limit_start - 1), &limit)){
+            append_string(reply, "error the limit has to be a number");
+            return false;
+        }
+        if(!lowercase(arg, prefix_len, word))
+            return false;       // no word is that long
+
+        unsigned long long found = 0;
+        for(uint64_t nr=result_index_lower_bound(index, word, prefix_len); nr<amount_of_words && found<limit; nr++, found++){
+            size_t word_len;
+            const char *candidate = result_index_word(index, nr, &word_len);
+            if(word_len < prefix_len || memcmp(candidate, word, prefix_len) != 0)
+                break;
+            append_word(reply, index, nr);
+        }
+        return false;
+    }
+
+    if(command_len == 3 && !memcmp(query, "top", 3)){
+        unsigned long long top = 0;
+        if(!parse_number(arg, arg_len, &top)){
+            append_string(reply, "error top needs a number");
+            return false;
+        }
+        for(uint64_t i=0; i<top && i<amount_of_words; i++)
+            append_word(reply, index, index->ranks[i]);
+        return false;
+    }
+
+    if(len == 8 && !memcmp(query, "shutdown", 8)){
+        append_string(reply, "ok");
+        return true;
+    }
+
+    append_string(reply, "error unknown query (expected get, prefix, top or shutdown)");
+    return false;
+}
+
+// receives all frames of the next request, returns false if the wait has been interrupted (or the socket is gone)
+static bool receive_queries(void *socket, query_list *queries){
+    int more = 1;
+    while(more){
+        if(queries->amount == queries->capacity){
+            queries->capacity = queries->capacity ? queries->capacity * 2 : 16;
+            queries->frames = (zmq_msg_t *) realloc(queries->frames, queries->capacity * sizeof(zmq_msg_t));
+            if(!queries->frames){
+                fprintf(stderr, "Could not allocate queries.\n");
+                exit(1);
+            }
+        }
+        zmq_msg_t *frame = &queries->frames[queries->amount];
+        zmq_msg_init(frame);
+        if(zmq_msg_recv(frame, socket, 0) < 0){
+            int error = zmq_errno();
+            zmq_msg_close(frame);
+            errno = error;
+            return false;
+        }
+        queries->amount++;
+        more = zmq_msg_more(frame);
+    }
+    return true;
+}
+
+void query_server_run(result_index *index, void *context, const char *endpoint){
+    assert(index);
+    assert(context);
+    assert(endpoint);
+
+    void *socket = zmq_socket(context, ZMQ_REP);
+    if(!socket){
+        fprintf(stderr, "Could not create ZMQ socket: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+    int linger = REPLY_LINGER_MS;
+    zmq_setsockopt(socket, ZMQ_LINGER, &linger, sizeof(linger));
+    if(zmq_bind(socket, endpoint) != 0){
+        fprintf(stderr, "Could not bind %s: %s\n", endpoint, zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    // SIGINT/ SIGTERM stop the service (no SA_RESTART, so the receive is interrupted)
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = request_stop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    fprintf(stderr, "Answering queries about %llu words on %s.\n", (unsigned long long) index->header->amount_of_words, endpoint);
+    reply_buffer reply = {0};
+    query_list queries = {0};
+    bool stopping = false;
+    while(!stopping && !stop_requested){
+        if(!receive_queries(socket, &queries)){
+            if(zmq_errno() == EINTR)
+                continue;
+            fprintf(stderr, "Could not receive query: %s\n", zmq_strerror(zmq_errno()));
+            break;
+        }
+
+        // REP only sends once the whole request has arrived, then every query gets its frame
+        for(size_t i=0; i<queries.amount; i++){
+            zmq_msg_t *query = &queries.frames[i];
+            if(answer(index, (const char *) zmq_msg_data(query), zmq_msg_size(query), &reply))
+                stopping = true;
+            if(zmq_send(socket, reply.data, reply.len, i + 1 < queries.amount ? ZMQ_SNDMORE : 0) < 0)
+                fprintf(stderr, "Could not send reply: %s\n", zmq_strerror(zmq_errno()));
+            zmq_msg_close(query);
+        }
+        queries.amount = 0;
+    }
+
+    for(size_t i=0; i<queries.amount; i++)
+        zmq_msg_close(&queries.frames[i]);
+    free(queries.frames);
+    free(reply.data);
+    zmq_close(socket);
+}
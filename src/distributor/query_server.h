@@ -0,0 +1,15 @@
+#pragma once
+
+// This header houses the query service of the distributor (--query <endpoint>)
+// it answers lookups of a finished result (see result_index.h) on a REP socket, nothing is counted anymore
+// every frame of a request is a query of its own, the reply has a frame per query in the same order, so a client can
+// batch as many lookups as it likes into one round trip:
+//   "get <word>"                    -> "<count>" (0 if the word hasn't been counted)
+//   "prefix <prefix> [<limit>]"     -> "word,count" per line, the words that start with prefix (alphabetically, at most limit)
+//   "top <n>"                       -> "word,count" per line, the n most frequent words (ties alphabetically)
+//   "shutdown"                      -> "ok", the service stops after the reply (so do SIGINT/ SIGTERM)
+// words are looked up in lowercase, like the workers count them, a query that can't be parsed gets "error <message>"
+#include "./result_index.h"
+
+// answers queries on the endpoint until a shutdown query (or SIGINT/ SIGTERM) arrives, the index stays open
+void query_server_run(result_index *index, void *context, const char *endpoint);
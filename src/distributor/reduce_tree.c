@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "./reduce_tree.h"
+
+// a level has to shrink the tables at least to this fraction, otherwise the distributor merges them right away
+// (the tables hold whatever words their chunks had, so once most words are in every table, merging them gains little)
+#define MIN_SHRINK 0.75
+
+// cuts the file into the chunks of the current level, its tables are written to a new file unless there are few enough
+// of them to go right into the counts, returns false if the file is empty
+static bool start_level(reduce_tree *tree, FILE *input){
+    fflush(input);
+    unsigned long long size = ftell(input);     // size of file in bytes
+    rewind(input);
+    if(size == 0)
+        return false;
+
+    tree->input = chunker_init(input, size);
+    chunker_set_word_ids(tree->input, tree->sched->dictionary != NULL);
+    tree->input_size = size;
+
+    // every chunk turns into one table (at most)
+    tree->tables = NULL;
+    if(tree->options.fan_in > 0 && size > tree->options.fan_in * MAX_CHUNK_LEN){
+        tree->tables = tmpfile();
+        if(!tree->tables){
+            fprintf(stderr, "Failed to create temporary file for the tables of the reduce tree with write privileges.\n");
+            exit(1);
+        }
+    }
+    return true;
+}
+
+// adds the tables of the file to the counts (the distributor merges them itself)
+static void merge_tables(reduce_tree *tree, FILE *tables){
+    fflush(tables);
+    unsigned long long size = ftell(tables);
+    rewind(tables);
+    if(size == 0)
+        return;
+
+    chunker *chunks = chunker_init(tables, size);
+    chunker_set_word_ids(chunks, tree->sched->dictionary != NULL);
+    char chunk[MAX_CHUNK_LEN + 1];
+    size_t len;
+    while((len = chunker_next(chunks, chunk, MAX_CHUNK_LEN)) > 0){
+        if(tree->sched->dictionary)
+            add_id_result_to_counts(chunk, len, &tree->ids);
+        else
+            add_reduce_result_to_hashmap(chunk, len, tree->counts);
+    }
+    chunker_destroy(chunks);
+}
+
+bool reduce_tree_init(reduce_tree *tree, scheduler *sched, FILE *map_results, hashmap *counts, const count_options *options){
+    assert(tree);
+    assert(sched);
+    assert(map_results);
+    assert(counts);
+    assert(options);
+
+    memset(tree, 0, sizeof(reduce_tree));
+    tree->sched = sched;
+    tree->counts = counts;
+    tree->options = *options;
+    tree->level = 1;
+    if(sched->dictionary)
+        id_counts_init(&tree->ids, counts, sched->dictionary);
+    return start_level(tree, map_results);
+}
+
+void reduce_tree_phase_init(reduce_tree *tree, scheduler_phase *phase, double weight){
+    assert(tree);
+    assert(tree->input);
+    assert(phase);
+
+    // the first level merges MAP results (ones, unless they are combined), the others merge tables (decimal)
+    // with word IDs both are the same
+    MSG_TYPE command = COMBINE;
+    if(tree->sched->dictionary)
+        command = RED_IDS;
+    else if(tree->level == 1 && !tree->options.combine)
+        command = RED;
+    if(tree->tables)
+        scheduler_phase_init(phase, tree->input, command, weight, save_map_result, tree->tables);
+    else if(tree->sched->dictionary)
+        scheduler_phase_init(phase, tree->input, command, weight, add_id_result_to_counts, &tree->ids);
+    else
+        scheduler_phase_init(phase, tree->input, command, weight, add_reduce_result_to_hashmap, tree->counts);
+}
+
+bool reduce_tree_next_level(reduce_tree *tree){
+    assert(tree);
+
+    chunker_destroy(tree->input);
+    tree->input = NULL;
+
+    // the tables of this level are the input of the next one, as long as they are worth another level
+    FILE *tables = tree->tables;
+    tree->tables = NULL;
+    if(tables){
+        if(tree->level_input)
+            fclose(tree->level_input);
+        tree->level_input = tables;
+        tree->level++;
+
+        fflush(tables);
+        if(ftell(tables) > MIN_SHRINK * tree->input_size)
+            merge_tables(tree, tables);
+        else if(start_level(tree, tables))
+            return true;
+    }
+
+    if(tree->sched->dictionary)
+        id_counts_flush(&tree->ids);
+    return false;
+}
+
+void reduce_tree_destroy(reduce_tree *tree){
+    assert(tree);
+    if(tree->input)
+        chunker_destroy(tree->input);
+    if(tree->tables)
+        fclose(tree->tables);
+    if(tree->level_input)
+        fclose(tree->level_input);
+    free(tree->ids.by_id);
+    memset(tree, 0, sizeof(reduce_tree));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// This header houses the RED phase of a count, either as a single level or as a tree (--tree <n>)
+// every RED task turns the MAP results of one chunk into a partial table, without a tree the distributor merges all of
+// these tables into the counts itself, that's a lot of parsing and hashing for one thread once there are many workers
+// with a tree the tables of a level are written to a file instead, which is cut into chunks again, so the workers merge
+// them (COMBINE, or RED_IDS with word IDs) into fewer, bigger tables, level by level, until a level has at most n tables
+// (or hardly shrinks anymore, e.g. if nearly every word is a different one), only those are merged by the distributor
+// workers don't talk to each other, so the distributor hands out the tasks of every level, but it only moves the bytes
+#include <stdio.h>
+#include <stdbool.h>
+#include "../lib/hashmap.h"
+#include "./chunker.h"
+#include "./scheduler.h"
+#include "./word_count.h"
+
+typedef struct{
+    scheduler *sched;
+    hashmap *counts;
+    id_counts ids;                  // RED results with word IDs (only if the scheduler has a dictionary)
+    count_options options;
+    unsigned int level;             // 1 -> RED of the MAP results
+    chunker *input;                 // chunks of the current level
+    unsigned long long input_size;
+    FILE *level_input;              // tables of the previous level (NULL on the first level, the MAP results are the caller's)
+    FILE *tables;                   // tables of the current level (NULL if they go right into the counts)
+}reduce_tree;
+
+// starts the first level over the MAP results (the file stays open), the results are added to counts in the end
+// returns false if there is nothing to reduce
+bool reduce_tree_init(reduce_tree *tree, scheduler *sched, FILE *map_results, hashmap *counts, const count_options *options);
+// sets up the phase of the current level (the phase is the caller's, it has to be destroyed before the next level starts)
+void reduce_tree_phase_init(reduce_tree *tree, scheduler_phase *phase, double weight);
+// once the phase of the current level is done: starts the next level and returns true, or adds the last tables to the
+// counts and returns false
+bool reduce_tree_next_level(reduce_tree *tree);
+// frees the files and chunkers of the tree (it doesn't have to be finished), the counts stay
+void reduce_tree_destroy(reduce_tree *tree);
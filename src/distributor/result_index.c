@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "./result_index.h"
+
+// buffer of the FILE the result is written with
+#define WRITE_BUFFER_LEN (1 << 20)
+
+typedef struct{
+    const char *word;       // key of the hashmap, it lives as long as the hashmap
+    size_t len;
+    int count;
+}indexed_word;
+
+typedef struct{
+    indexed_word *words;
+    size_t amount;
+    size_t capacity;
+}word_list;
+
+// the number of a word and its count, to sort the ranks
+typedef struct{
+    int count;
+    uint32_t nr;
+}ranked_word;
+
+static uint64_t hash_word(const char *word, size_t len){
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(size_t i=0; i<len; i++){
+        hash ^= (unsigned char) word[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static inline uint64_t align_8(uint64_t offset){
+    return (offset + 7) & ~(uint64_t) 7;
+}
+
+// helper for result_index_write, collects every word that has been counted
+static void collect_word(void *key, void *value, void *arg){
+    word_list *list = (word_list *) arg;
+    const char *word = (const char *) key;
+    int count = *(int *) value;
+    if(word[0] == '\0' || count <= 0)
+        return;
+
+    if(list->amount == list->capacity){
+        list->capacity = list->capacity ? list->capacity * 2 : 1024;
+        list->words = (indexed_word *) realloc(list->words, list->capacity * sizeof(indexed_word));
+        if(!list->words){
+            fprintf(stderr, "Could not allocate result index.\n");
+            exit(1);
+        }
+    }
+    list->words[list->amount++] = (indexed_word){word, strlen(word), count};
+}
+
+static int compare_words(const void *a, const void *b){
+    return strcmp(((const indexed_word *) a)->word, ((const indexed_word *) b)->word);
+}
+
+// most frequent first, the words are sorted already, so ties are sorted by their numbers
+static int compare_ranks(const void *a, const void *b){
+    const ranked_word *one = (const ranked_word *) a;
+    const ranked_word *two = (const ranked_word *) b;
+    if(one->count != two->count)
+        return one->count > two->count ? -1 : 1;
+    return (one->nr > two->nr) - (one->nr < two->nr);
+}
+
+// writes the sections to the file, returns false if it couldn't be written
+static bool write_index(hashmap *counts, FILE *file){
+    word_list list = {0};
+    hashmap_for_each(counts, collect_word, &list);
+    qsort(list.words, list.amount, sizeof(indexed_word), compare_words);
+    if(list.amount >= UINT32_MAX){
+        fprintf(stderr, "Too many words for a result index.\n");
+        exit(1);
+    }
+
+    // every section is built in memory first, the file is then written from front to back
+    size_t amount = list.amount;
+    uint64_t buckets = 1;
+    while(buckets < 2 * (uint64_t) amount)
+        buckets <<= 1;
+
+    uint64_t *word_counts = (uint64_t *) malloc((amount + 1) * sizeof(uint64_t));
+    uint64_t *offsets = (uint64_t *) malloc((amount + 1) * sizeof(uint64_t));
+    ranked_word *ranked = (ranked_word *) malloc((amount + 1) * sizeof(ranked_word));
+    uint32_t *ranks = (uint32_t *) malloc((amount + 1) * sizeof(uint32_t));
+    uint32_t *index = (uint32_t *) calloc(buckets, sizeof(uint32_t));
+    if(!word_counts || !offsets || !ranked || !ranks || !index){
+        fprintf(stderr, "Could not allocate result index.\n");
+        exit(1);
+    }
+
+    result_header header = {0};
+    memcpy(header.magic, RESULT_INDEX_MAGIC, sizeof(header.magic));
+    uint64_t words_len = 0;
+    for(size_t i=0; i<amount; i++){
+        word_counts[i] = (uint64_t) list.words[i].count;
+        offsets[i] = words_len;
+        ranked[i] = (ranked_word){list.words[i].count, (uint32_t) i};
+        words_len += sizeof(uint16_t) + list.words[i].len + 1;
+        header.total += word_counts[i];
+
+        uint64_t bucket = hash_word(list.words[i].word, list.words[i].len) & (buckets - 1);
+        while(index[bucket] != 0)
+            bucket = (bucket + 1) & (buckets - 1);
+        index[bucket] = (uint32_t) i + 1;
+    }
+    qsort(ranked, amount, sizeof(ranked_word), compare_ranks);
+    for(size_t i=0; i<amount; i++)
+        ranks[i] = ranked[i].nr;
+
+    header.amount_of_words = amount;
+    header.amount_of_buckets = buckets;
+    header.counts_offset = sizeof(result_header);
+    header.offsets_offset = header.counts_offset + amount * sizeof(uint64_t);
+    header.ranks_offset = header.offsets_offset + amount * sizeof(uint64_t);
+    header.index_offset = align_8(header.ranks_offset + amount * sizeof(uint32_t));
+    header.words_offset = align_8(header.index_offset + buckets * sizeof(uint32_t));
+    header.size = header.words_offset + words_len;
+
+    static const char padding[8] = {0};
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(word_counts, sizeof(uint64_t), amount, file);
+    fwrite(offsets, sizeof(uint64_t), amount, file);
+    fwrite(ranks, sizeof(uint32_t), amount, file);
+    fwrite(padding, 1, header.index_offset - (header.ranks_offset + amount * sizeof(uint32_t)), file);
+    fwrite(index, sizeof(uint32_t), buckets, file);
+    fwrite(padding, 1, header.words_offset - (header.index_offset + buckets * sizeof(uint32_t)), file);
+    for(size_t i=0; i<amount; i++){
+        uint16_t len = (uint16_t) list.words[i].len;
+        fwrite(&len, sizeof(len), 1, file);
+        fwrite(list.words[i].word, 1, list.words[i].len + 1, file);
+    }
+
+    free(word_counts);
+    free(offsets);
+    free(ranked);
+    free(ranks);
+    free(index);
+    free(list.words);
+    return fflush(file) == 0 && !ferror(file);
+}
+
+void result_index_write(hashmap *counts, const char *path){
+    assert(counts);
+    assert(path);
+
+    // written under another name first, so nobody maps half a result
+    char temp_path[4096 + 32];
+    snprintf(temp_path, sizeof(temp_path), "%s.%ld", path, (long) getpid());
+    FILE *file = fopen(temp_path, "w");
+    if(!file){
+        fprintf(stderr, "Could not write result index to %s\n", path);
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, WRITE_BUFFER_LEN);
+
+    bool written = write_index(counts, file);
+    if(fclose(file) != 0 || !written || rename(temp_path, path) != 0){
+        unlink(temp_path);
+        fprintf(stderr, "Could not write result index to %s\n", path);
+        exit(1);
+    }
+}
+
+// returns true if the sections of the header lie within the file
+static bool is_valid(const result_header *header, size_t size){
+    uint64_t words = header->amount_of_words;
+    uint64_t buckets = header->amount_of_buckets;
+    if(memcmp(header->magic, RESULT_INDEX_MAGIC, sizeof(header->magic)) != 0 || header->size != size)
+        return false;
+    if(words >= UINT32_MAX || buckets == 0 || (buckets & (buckets - 1)) != 0 || buckets < words || buckets > size)
+        return false;
+    return header->counts_offset >= sizeof(result_header) && header->counts_offset % 8 == 0 &&
+           header->offsets_offset % 8 == 0 && header->index_offset % 8 == 0 &&
+           header->counts_offset + words * sizeof(uint64_t) <= size &&
+           header->offsets_offset + words * sizeof(uint64_t) <= size &&
+           header->ranks_offset + words * sizeof(uint32_t) <= size &&
+           header->index_offset + buckets * sizeof(uint32_t) <= size &&
+           header->words_offset <= size;
+}
+
+// maps the result file, the fd can be closed afterwards, returns NULL if it isn't a result file
+static result_index* map_index(int fd){
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(result_header))
+        return NULL;
+    size_t size = (size_t) info.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if(data == MAP_FAILED)
+        return NULL;
+
+    const result_header *header = (const result_header *) data;
+    if(!is_valid(header, size)){
+        munmap(data, size);
+        return NULL;
+    }
+
+    result_index *index = (result_index *) calloc(1, sizeof(result_index));
+    if(!index){
+        fprintf(stderr, "Could not allocate result index.\n");
+        exit(1);
+    }
+    index->data = (const char *) data;
+    index->size = size;
+    index->header = header;
+    index->counts = (const uint64_t *) &index->data[header->counts_offset];
+    index->offsets = (const uint64_t *) &index->data[header->offsets_offset];
+    index->ranks = (const uint32_t *) &index->data[header->ranks_offset];
+    index->index = (const uint32_t *) &index->data[header->index_offset];
+    index->words = &index->data[header->words_offset];
+    return index;
+}
+
+result_index* result_index_open(const char *path){
+    assert(path);
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+    result_index *index = map_index(fd);
+    close(fd);
+    return index;
+}
+
+result_index* result_index_from_counts(hashmap *counts){
+    assert(counts);
+
+    // a temporary file is gone as soon as it's closed, the mapping stays
+    FILE *file = tmpfile();
+    if(!file){
+        fprintf(stderr, "Failed to create temporary file for the result index.\n");
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, WRITE_BUFFER_LEN);
+    result_index *index = write_index(counts, file) ? map_index(fileno(file)) : NULL;
+    fclose(file);
+    if(!index){
+        fprintf(stderr, "Could not build result index.\n");
+        exit(1);
+    }
+    return index;
+}
+
+const char* result_index_word(result_index *index, uint64_t nr, size_t *len){
+    assert(index);
+    assert(nr < index->header->amount_of_words);
+
+    const char *entry = &index->words[index->offsets[nr]];
+    uint16_t word_len;
+    memcpy(&word_len, entry, sizeof(word_len));
+    if(len)
+        *len = word_len;
+    return entry + sizeof(word_len);
+}
+
+uint64_t result_index_count(result_index *index, uint64_t nr){
+    assert(index);
+    assert(nr < index->header->amount_of_words);
+    return index->counts[nr];
+}
+
+int64_t result_index_find(result_index *index, const char *word, size_t len){
+    assert(index);
+    assert(word || len == 0);
+
+    uint64_t mask = index->header->amount_of_buckets - 1;
+    uint64_t bucket = hash_word(word, len) & mask;
+    // there are at least twice as many buckets as words, so there is always an empty one
+    for(uint64_t probes=0; probes<=mask && index->index[bucket] != 0; probes++){
+        uint64_t nr = index->index[bucket] - 1;
+        size_t word_len;
+        const char *candidate = result_index_word(index, nr, &word_len);
+        if(word_len == len && !memcmp(candidate, word, len))
+            return (int64_t) nr;
+        bucket = (bucket + 1) & mask;
+    }
+    return -1;
+}
+
+// <0, 0 or >0, like strcmp, but the word doesn't have to be NUL terminated
+static int compare_to(result_index *index, uint64_t nr, const char *word, size_t len){
+    size_t word_len;
+    const char *candidate = result_index_word(index, nr, &word_len);
+    int result = memcmp(candidate, word, word_len < len ? word_len : len);
+    if(result != 0)
+        return result;
+    return (word_len > len) - (word_len < len);
+}
+
+uint64_t result_index_lower_bound(result_index *index, const char *prefix, size_t len){
+    assert(index);
+    assert(prefix || len == 0);
+
+    uint64_t low = 0;
+    uint64_t high = index->header->amount_of_words;
+    while(low < high){
+        uint64_t middle = low + (high - low) / 2;
+        if(compare_to(index, middle, prefix, len) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+void result_index_close(result_index *index){
+    assert(index);
+    munmap((void *) index->data, index->size);
+    free(index);
+}
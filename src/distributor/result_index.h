@@ -0,0 +1,60 @@
+#pragma once
+
+// This header houses the binary result file (--index <file>)
+// the csv has to be parsed completely before a single count can be looked up, this file can be mapped as it is instead:
+// every section starts at a multiple of 8 bytes, all numbers are little endian (the byte order of the machines we run on)
+//   header       result_header (below)
+//   counts       uint64_t per word, in the order of the words
+//   offsets      uint64_t per word, where its entry starts within the words section
+//   ranks        uint32_t per word: the numbers of the words, most frequent first (ties alphabetically), like the csv
+//   index        uint32_t per bucket: number of the word + 1 (0 -> empty), open addressing with linear probing
+//                the bucket of a word is the FNV-1a hash of its bytes modulo the amount of buckets (a power of 2)
+//   words        per word (sorted by their bytes): uint16_t length, the bytes and a NUL
+// a lookup is a hash, a probe or two and a compare, a prefix is a binary search over the sorted words
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../lib/hashmap.h"
+
+#define RESULT_INDEX_MAGIC "ZMQWCIX1"
+
+typedef struct{
+    char magic[8];                      // RESULT_INDEX_MAGIC, the version is part of it
+    uint64_t amount_of_words;
+    uint64_t amount_of_buckets;
+    uint64_t total;                     // sum of all counts
+    uint64_t counts_offset;             // offsets of the sections from the start of the file
+    uint64_t offsets_offset;
+    uint64_t ranks_offset;
+    uint64_t index_offset;
+    uint64_t words_offset;
+    uint64_t size;                      // of the whole file, a shorter one has been cut off
+}result_header;
+
+// a result file mapped read only
+typedef struct{
+    const char *data;
+    size_t size;
+    const result_header *header;
+    const uint64_t *counts;
+    const uint64_t *offsets;
+    const uint32_t *ranks;
+    const uint32_t *index;
+    const char *words;
+}result_index;
+
+// writes the counts (word (char[MSG_LEN]) -> count (int), see word_counts_init) to path, exits if it can't be written
+void result_index_write(hashmap *counts, const char *path);
+// maps the file at path, returns NULL if it can't be opened or isn't a result file
+result_index* result_index_open(const char *path);
+// same, but the counts are written to a temporary file that's mapped right away (exits if that fails)
+result_index* result_index_from_counts(hashmap *counts);
+// returns the number of the word (0 .. amount_of_words - 1) or -1 if it hasn't been counted
+int64_t result_index_find(result_index *index, const char *word, size_t len);
+// the word with that number (NUL terminated), *len is set to its length
+const char* result_index_word(result_index *index, uint64_t nr, size_t *len);
+uint64_t result_index_count(result_index *index, uint64_t nr);
+// number of the first word that starts with prefix (or is behind it), amount_of_words if there is none
+uint64_t result_index_lower_bound(result_index *index, const char *prefix, size_t len);
+void result_index_close(result_index *index);
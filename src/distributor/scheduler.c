@@ -0,0 +1,1357 @@
+#include <zmq.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include "./scheduler.h"
+
+// a running task counts as straggler once it took STRAGGLER_FACTOR times the median task time of the phase
+#define STRAGGLER_FACTOR 2.0
+// but never before STRAGGLER_MIN_MS, otherwise tiny tasks get duplicated just because of scheduling noise
+#define STRAGGLER_MIN_MS 50.0
+// the median is meaningless if only a handful of tasks have finished yet
+#define STRAGGLER_MIN_SAMPLES 3
+// amount of workers that may work on the same task at once (original + copies)
+#define MAX_TASK_COPIES 2
+// a request that hasn't been answered after this many ms counts as failed
+// a task that failed this many times is considered to be poison (it probably crashes the workers)
+#define MAX_TASK_ATTEMPTS 4
+// a worker is evicted after this many consecutive failed requests
+#define MAX_WORKER_FAILURES 3
+// smallest task that is handed out, below that the round trip dominates
+#define MIN_TASK_LEN 128
+// weight of a new measurement in the moving average of a worker's throughput
+#define RATE_WEIGHT 0.25
+// workers that reach at least this fraction of the fastest worker's throughput get full sized tasks (measurements are noisy)
+#define RATE_TOLERANCE 0.8
+// tasks shrink once less than TAIL_ROUNDS rounds of full sized tasks are left, so all workers finish at about the same time
+#define TAIL_ROUNDS 2
+// how often the input is checked while the readers are behind (ms)
+#define INPUT_WAIT_MS 10
+// a worker may register with at most this many threads
+#define MAX_WORKER_THREADS 1024
+// and may buffer at most this many tasks (one slot per credit)
+#define MAX_WORKER_CREDITS 4096
+
+typedef struct{
+    unsigned long id;
+    const char *data;           // the chunk (not NUL terminated), points into the mapped input or to owned
+    size_t len;
+    char *owned;                // copy of the chunk if the input isn't mapped
+    input_mapping *mapping;     // reference to the mapped input, it's kept alive as long as the task exists
+    double started_at;          // ms, time the task has been sent for the first time
+    unsigned int copies;        // amount of workers currently working on this task
+    unsigned int attempts;      // amount of requests with this task that timed out
+    scheduler_phase *phase;     // the task belongs to it (its command, result handler and durations)
+    bool cacheable;             // the result goes into the chunk cache
+    chunk_key key;              // of the chunk in the cache
+}running_task;
+
+// reply of a worker, the payload points into msg (zmq) or buffer (shared memory), it isn't copied around
+typedef struct{
+    zmq_msg_t msg;
+    char buffer[MSG_LEN];
+    const char *payload;
+    size_t len;
+}worker_reply;
+
+static void handle_timeout(scheduler *sched, int worker_nr);
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int compare_doubles(const void *a, const void *b){
+    double one = *(const double *)a;
+    double two = *(const double *)b;
+    return (one > two) - (one < two);
+}
+
+static void duration_list_add(duration_list *durations, double value){
+    if(durations->amount == durations->capacity){
+        durations->capacity = durations->capacity ? durations->capacity * 2 : 64;
+        durations->values = (double *) realloc(durations->values, durations->capacity * sizeof(double));
+        if(!durations->values){
+            fprintf(stderr, "Could not allocate memory for task durations.\n");
+            exit(1);
+        }
+    }
+    durations->values[durations->amount++] = value;
+}
+
+// sorts the durations in place, which doesn't matter since the order is irrelevant
+// the median is only recomputed every 64 tasks once there are enough values (it barely moves by then)
+static double duration_list_median(duration_list *durations){
+    assert(durations->amount > 0);
+    if(durations->median_amount != durations->amount && (durations->amount < 64 || durations->amount % 64 == 0)){
+        qsort(durations->values, durations->amount, sizeof(double), compare_doubles);
+        durations->median = durations->values[durations->amount / 2];
+        durations->median_amount = durations->amount;
+    }
+    return durations->median;
+}
+
+// returns the time in ms after which a task counts as straggler or -1 if it can't be told yet
+static double straggler_threshold(duration_list *durations){
+    if(durations->amount < STRAGGLER_MIN_SAMPLES)
+        return -1;
+
+    double threshold = STRAGGLER_FACTOR * duration_list_median(durations);
+    if(threshold < STRAGGLER_MIN_MS)
+        threshold = STRAGGLER_MIN_MS;
+    return threshold;
+}
+
+// shm:// workers create their shared memory when they start, so the distributor waits a little for it
+static void open_channel(scheduler *sched, worker_slot *worker){
+    const char *name = &worker->endpoint[strlen("shm:/")];     // keeps the '/' -> "/<name>"
+    double deadline = now_ms() + sched->request_timeout;
+    while(!(worker->channel = shm_channel_open(name))){
+        if(now_ms() > deadline){
+            fprintf(stderr, "Could not open shared memory of %s.\n", worker->endpoint);
+            exit(1);
+        }
+        struct timespec pause = {0, 10 * 1000 * 1000};
+        nanosleep(&pause, NULL);
+    }
+}
+
+// creates a fresh REQ socket for the worker and connects it
+// a REQ socket can't send again before it received a reply, so this is also how a socket is reset after a timeout
+static void connect_worker(scheduler *sched, worker_slot *worker){
+    worker->socket = zmq_socket(sched->context, ZMQ_REQ);
+    if(!worker->socket){
+        fprintf(stderr, "Could not create ZMQ socket: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    // don't wait for unanswered requests on close
+    int linger = 0;
+    zmq_setsockopt(worker->socket, ZMQ_LINGER, &linger, sizeof(linger));
+
+    // shm:// workers only get notifications over zmq
+    char endpoint[ENDPOINT_LEN];
+    strcpy(endpoint, worker->endpoint);
+    if(!strncmp(worker->endpoint, "shm://", 6)){
+        if(!worker->channel)
+            open_channel(sched, worker);
+        if(shm_notify_endpoint(&worker->endpoint[strlen("shm:/")], endpoint, sizeof(endpoint)) != 0){
+            fprintf(stderr, "No notification endpoint for shared memory %s\n", worker->endpoint);
+            exit(1);
+        }
+    }
+
+    if(zmq_connect(worker->socket, endpoint) != 0){
+        fprintf(stderr, "Could not connect to %s (ZMQ error): %s\n", endpoint, zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+}
+
+// returns true if the worker may get new tasks
+static inline bool accepts_tasks(worker_slot *worker){
+    return !worker->evicted && !worker->leaving;
+}
+
+// returns true if a task can be sent to the worker right now (registered workers need a credit)
+static inline bool has_credit(scheduler *sched, worker_slot *worker){
+    return !worker->registered || sched->connections[worker->connection].credits > 0;
+}
+
+// returns the index of the host with the given name, workers with the same host name share it
+static size_t host_index(scheduler *sched, const char *host_name){
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        if(!strcmp(sched->workers[i].host_name, host_name))
+            return sched->workers[i].host;
+    }
+    return sched->amount_of_hosts++;
+}
+
+// appends an empty worker slot (this may move the slots, so don't keep pointers to them across calls)
+static worker_slot* add_worker_slot(scheduler *sched, const char *host_name, double weight){
+    assert(weight > 0);
+    if(sched->amount_of_workers == sched->capacity){
+        sched->capacity = sched->capacity ? sched->capacity * 2 : 8;
+        sched->workers = (worker_slot *) realloc(sched->workers, sched->capacity * sizeof(worker_slot));
+        if(!sched->workers){
+            fprintf(stderr, "Could not allocate worker slots.\n");
+            exit(1);
+        }
+    }
+
+    size_t host = host_index(sched, host_name);
+    worker_slot *worker = &sched->workers[sched->amount_of_workers++];
+    memset(worker, 0, sizeof(worker_slot));
+    strncpy(worker->host_name, host_name, ENDPOINT_LEN-1);
+    worker->host = host;
+    worker->weight = weight;
+    sched->amount_of_live_workers++;
+    return worker;
+}
+
+// creates the ROUTER socket workers register at
+static void listen_for_workers(scheduler *sched, const char *endpoint){
+    sched->router = zmq_socket(sched->context, ZMQ_ROUTER);
+    if(!sched->router){
+        fprintf(stderr, "Could not create ZMQ socket: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    // sending to a worker that is gone fails instead of silently dropping the message
+    int mandatory = 1;
+    int linger = 0;
+    zmq_setsockopt(sched->router, ZMQ_ROUTER_MANDATORY, &mandatory, sizeof(mandatory));
+    zmq_setsockopt(sched->router, ZMQ_LINGER, &linger, sizeof(linger));
+
+    if(zmq_bind(sched->router, endpoint) != 0){
+        fprintf(stderr, "Could not bind to %s (ZMQ error): %s\n", endpoint, zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+}
+
+scheduler* scheduler_init(void *context, worker_spec specs[], size_t amount_of_workers, const char *listen_endpoint){
+    assert(context);
+    assert(specs || amount_of_workers == 0);
+    assert(amount_of_workers > 0 || listen_endpoint);
+
+    scheduler *sched = (scheduler *) calloc(1, sizeof(scheduler));
+    if(!sched){
+        fprintf(stderr, "Could not allocate scheduler.\n");
+        exit(1);
+    }
+
+    sched->context = context;
+    sched->running_tasks = list_init(sizeof(running_task));
+    sched->retry_queue = list_init(sizeof(running_task));
+    sched->request_timeout = DEFAULT_REQUEST_TIMEOUT_MS;
+
+    for(size_t i=0; i<amount_of_workers; i++){
+        worker_slot *worker = add_worker_slot(sched, specs[i].host, specs[i].weight);
+        strncpy(worker->endpoint, specs[i].endpoint, ENDPOINT_LEN-1);
+        connect_worker(sched, worker);
+    }
+
+    if(listen_endpoint)
+        listen_for_workers(sched, listen_endpoint);
+
+    return sched;
+}
+
+// returns the running task with the given id or NULL if it already has been answered
+static running_task* find_running_task(scheduler *sched, unsigned long id, size_t *index){
+    size_t pos = 0;
+    struct list_node *curr = sched->running_tasks->first;
+    while(curr){
+        running_task *task = (running_task *) curr->data;
+        if(task->id == id){
+            if(index)
+                *index = pos;
+            return task;
+        }
+        curr = curr->next;
+        pos++;
+    }
+    return NULL;
+}
+
+static void free_task(running_task *task){
+    free(task->owned);
+    if(task->mapping)
+        chunker_release(NULL, task->mapping);
+}
+
+// removes every task of the phase from the lists and gives the phase up, late replies to its tasks are discarded
+static void remove_phase_tasks(list_head *tasks, scheduler_phase *phase){
+    size_t index = 0;
+    struct list_node *curr = tasks->first;
+    while(curr){
+        running_task *task = (running_task *) curr->data;
+        curr = curr->next;
+        if(task->phase != phase){
+            index++;
+            continue;
+        }
+        running_task removed;
+        list_remove_node(tasks, index, &removed);
+        free_task(&removed);
+    }
+}
+
+static void fail_phase(scheduler *sched, scheduler_phase *phase){
+    remove_phase_tasks(sched->running_tasks, phase);
+    remove_phase_tasks(sched->retry_queue, phase);
+    phase->running = 0;
+    phase->failed = true;
+}
+
+// the request of the worker failed (timeout) or has been rejected, the task is handed to the next free worker
+// unless another worker is working on a copy of it
+static void requeue_request(scheduler *sched, int worker_nr, bool failed){
+    worker_slot *worker = &sched->workers[worker_nr];
+    assert(worker->busy);
+    worker->busy = false;
+
+    size_t index = 0;
+    running_task *task = find_running_task(sched, worker->task_id, &index);
+    if(!task)
+        return;
+
+    task->copies--;
+    if(failed)
+        task->attempts++;
+    if(task->attempts >= MAX_TASK_ATTEMPTS){
+        fprintf(stderr, "Task %lu failed %u times, giving up its phase.\n", task->id, task->attempts);
+        fail_phase(sched, task->phase);
+        return;
+    }
+
+    if(task->copies == 0){
+        running_task retry;
+        list_remove_node(sched->running_tasks, index, &retry);
+        list_insert_back(sched->retry_queue, &retry);
+    }
+}
+
+// sends [identity][task id][command][chunk] to a registered worker, returns 0 on success
+// data is the chunk of the task or a copy of it (with a dictionary update in front)
+// a mapped chunk is sent without copying it, zmq keeps a reference to the mapping until the message is gone
+static int send_routed_task(scheduler *sched, connection *conn, running_task *task, MSG_TYPE command, const char *data, size_t len){
+    if(zmq_send(sched->router, conn->identity, conn->identity_len, ZMQ_SNDMORE) < 0)
+        return 1;       // EHOSTUNREACH: the worker is gone, nothing has been sent
+
+    char id[24];
+    char prefix[MSG_LEN] = {0};
+    snprintf(id, sizeof(id), "%lu", task->id);
+    encode_msg_to_worker(prefix, "", command);
+    zmq_send(sched->router, id, strlen(id), ZMQ_SNDMORE);
+    zmq_send(sched->router, prefix, strlen(prefix), ZMQ_SNDMORE);
+
+    if(!task->mapping || data != task->data)
+        return zmq_send(sched->router, data, len, 0) < 0;
+
+    zmq_msg_t chunk;
+    zmq_msg_init_data(&chunk, (void *) task->data, task->len, chunker_release, chunker_retain(task->mapping));
+    if(zmq_msg_send(&chunk, sched->router, 0) < 0){
+        zmq_msg_close(&chunk);
+        return 1;
+    }
+    return 0;
+}
+
+// sends [identity][msg] to a registered worker, returns 0 on success
+static int send_routed(scheduler *sched, connection *conn, const char *msg, size_t len){
+    if(zmq_send(sched->router, conn->identity, conn->identity_len, ZMQ_SNDMORE) < 0)
+        return 1;
+    return zmq_send(sched->router, msg, len, 0) < 0;
+}
+
+// removes every slot of a registered worker from the rotation (it said bye and is done or it's unreachable)
+static void remove_registered_worker(scheduler *sched, size_t conn_nr){
+    sched->connections[conn_nr].gone = true;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!worker->registered || worker->connection != conn_nr || worker->evicted)
+            continue;
+
+        if(!worker->leaving)
+            sched->amount_of_live_workers--;
+        worker->evicted = true;
+        worker->busy = false;
+    }
+}
+
+// returns false if the task couldn't be sent, because the (registered) worker is gone or has no credit left
+static bool send_task(scheduler *sched, int worker_nr, running_task *task){
+    worker_slot *worker = &sched->workers[worker_nr];
+    MSG_TYPE command = task->phase->command;
+    assert(!worker->busy);
+
+    // MAP_IDS: the words the worker hasn't got yet go in front of the chunk (which is copied then, even if it's mapped)
+    const char *data = task->data;
+    size_t len = task->len;
+    size_t *known_words = worker->registered ? &sched->connections[worker->connection].known_words : &worker->known_words;
+    size_t sent_words = *known_words;
+    char payload[MSG_LEN];
+    if(command == MAP_IDS){
+        assert(sched->dictionary);
+        // a chunk only grows beyond its max_len if a word is longer than that, then there is less room for the update
+        // (but the chunker splits a word before it leaves less than the smallest update, see cut_task)
+        size_t room = MAX_CHUNK_LEN - task->len;
+        assert(task->len <= MAX_CHUNK_LEN - 2 * VARINT_LEN);
+        size_t update_len = room < DICTIONARY_UPDATE_LEN ? room : DICTIONARY_UPDATE_LEN;
+        len = word_dictionary_write_update(sched->dictionary, *known_words, payload, update_len, &sent_words);
+        memcpy(&payload[len], task->data, task->len);
+        len += task->len;
+        data = payload;
+    }
+
+    if(worker->registered){
+        connection *conn = &sched->connections[worker->connection];
+        if(conn->credits == 0)
+            return false;
+        if(send_routed_task(sched, conn, task, command, data, len) != 0){
+            fprintf(stderr, "Worker %s is unreachable, removing it.\n", conn->host_name);
+            remove_registered_worker(sched, worker->connection);
+            return false;
+        }
+        conn->credits--;
+        conn->known_words = sent_words;     // the worker takes the update even if it has to reject the task
+    }
+    else if(worker->channel){
+        // the command and the chunk are encoded right into the ring (the chunk is copied once, from the input)
+        // the worker reads at least one request per notification, so there are just a few stale ones at most
+        char id[24];
+        char prefix[MSG_LEN] = {0};
+        snprintf(id, sizeof(id), "%lu", task->id);
+        encode_msg_to_worker(prefix, "", command);
+        struct iovec parts[3] = {{prefix, strlen(prefix)}, {(void *) data, len}, {"", 1}};
+        if(shm_ring_write_parts(&worker->channel->requests, task->id, parts, 3) != 0){
+            fprintf(stderr, "Shared memory of %s is full.\n", worker->endpoint);
+            exit(1);
+        }
+        if(zmq_send(worker->socket, id, strlen(id)+1, 0) < 0){
+            fprintf(stderr, "Could not send task to %s: %s\n", worker->endpoint, zmq_strerror(zmq_errno()));
+            exit(1);
+        }
+    }
+    else{
+        // a REQ socket needs the command and the chunk in one piece, which is encoded right into the message
+        zmq_msg_t msg;
+        if(encode_msg_to_worker_zmq(&msg, data, len, command) != 0){
+            fprintf(stderr, "Could not encode message.\n\n");
+            exit(1);
+        }
+        if(zmq_msg_send(&msg, worker->socket, 0) < 0){
+            fprintf(stderr, "Could not send task to %s: %s\n", worker->endpoint, zmq_strerror(zmq_errno()));
+            exit(1);
+        }
+    }
+
+    worker->busy = true;
+    worker->task_id = task->id;
+    worker->command = command;
+    worker->sent_at = now_ms();
+    worker->sent_bytes = task->len;
+    task->copies++;
+    return true;
+}
+
+// bookkeeping once a busy worker replied
+// returns the running task the reply belongs to or NULL if another copy of the task already won
+static running_task* complete_request(scheduler *sched, int worker_nr, size_t *index){
+    worker_slot *worker = &sched->workers[worker_nr];
+    assert(worker->busy);
+
+    // update throughput of the worker (the round trip is part of it on purpose)
+    double elapsed = now_ms() - worker->sent_at;
+    if(worker->sent_bytes > 0 && elapsed > 0){
+        double rate = worker->sent_bytes / elapsed;
+        worker->rate = worker->rate > 0 ? (1 - RATE_WEIGHT) * worker->rate + RATE_WEIGHT * rate : rate;
+    }
+
+    worker->busy = false;
+    worker->failures = 0;
+    return find_running_task(sched, worker->task_id, index);
+}
+
+// a MAP_IDS reply starts with the amount of words the worker knows, that's taken off before the result is handled
+// registered workers get their updates in order, so they know every word that has been sent to them already
+static void take_known_words(worker_slot *worker, worker_reply *reply){
+    size_t pos = 0;
+    uint32_t known_words = 0;
+    if(worker->command != MAP_IDS || !varint_get(reply->payload, reply->len, &pos, WORD_ID_BYTE, &known_words))
+        return;
+    reply->payload += pos;
+    reply->len -= pos;
+    if(!worker->registered)
+        worker->known_words = known_words;
+}
+
+static void reply_init(worker_reply *reply){
+    zmq_msg_init(&reply->msg);
+    reply->payload = "";
+    reply->len = 0;
+}
+
+// frees the message, the payload is gone afterwards
+static void reply_close(worker_reply *reply){
+    zmq_msg_close(&reply->msg);
+    reply_init(reply);
+}
+
+// receives the reply of a busy worker with a REQ socket (the reply has to be initialized)
+static running_task* receive_reply(scheduler *sched, int worker_nr, worker_reply *reply, size_t *index){
+    worker_slot *worker = &sched->workers[worker_nr];
+    assert(worker->busy && !worker->registered);
+
+    if(zmq_msg_recv(&reply->msg, worker->socket, 0) < 0){
+        fprintf(stderr, "Could not receive reply from %s: %s\n", worker->endpoint, zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+    msg_view view = decode_msg_view_from_worker((const char *) zmq_msg_data(&reply->msg), zmq_msg_size(&reply->msg));
+
+    // shm:// -> the reply is the id of the result in the shared memory, older results have been discarded
+    if(worker->channel){
+        uint64_t id = 0;
+        long len = -1;
+        if(view.len > 0 && view.payload[0] != '-'){
+            do{
+                len = shm_ring_read(&worker->channel->replies, &id, reply->buffer, MSG_LEN-1);
+            }while(len >= 0 && id != worker->task_id);
+        }
+        if(len < 0){
+            handle_timeout(sched, worker_nr);   // the worker lost the task, same as if it never answered
+            return NULL;
+        }
+        view = decode_msg_view_from_worker(reply->buffer, len < MSG_LEN ? (size_t) len : MSG_LEN-1);
+    }
+
+    reply->payload = view.payload;
+    reply->len = view.len;
+    take_known_words(worker, reply);
+    return complete_request(sched, worker_nr, index);
+}
+
+// returns the index of the connection with the given routing id or -1
+static int find_connection(scheduler *sched, const char *identity, size_t identity_len){
+    for(size_t i=0; i<sched->amount_of_connections; i++){
+        connection *conn = &sched->connections[i];
+        if(!conn->gone && conn->identity_len == identity_len && !memcmp(conn->identity, identity, identity_len))
+            return (int) i;
+    }
+    return -1;
+}
+
+// "hey<threads> <host> [<credits>]": adds one slot per credit (a worker without credits gets one per thread)
+// the slots of a worker share its threads, so together they weigh as much as the threads
+static void register_worker(scheduler *sched, const char *identity, size_t identity_len, char *payload){
+    char *end = NULL;
+    long threads = strtol(payload, &end, 10);
+    char host[ENDPOINT_LEN] = {0};
+    long credits = threads;
+    int fields = sscanf(end, " %255s %ld", host, &credits);
+    if(threads < 1 || threads > MAX_WORKER_THREADS || fields < 1 || credits < threads || credits > MAX_WORKER_CREDITS){
+        fprintf(stderr, "Ignoring invalid registration: hey%s\n", payload);
+        return;
+    }
+
+    // a worker that registers twice keeps its slots
+    if(find_connection(sched, identity, identity_len) != -1)
+        return;
+
+    if(sched->amount_of_connections == sched->connections_capacity){
+        sched->connections_capacity = sched->connections_capacity ? sched->connections_capacity * 2 : 8;
+        sched->connections = (connection *) realloc(sched->connections, sched->connections_capacity * sizeof(connection));
+        if(!sched->connections){
+            fprintf(stderr, "Could not allocate connections.\n");
+            exit(1);
+        }
+    }
+    size_t conn_nr = sched->amount_of_connections++;
+    connection *conn = &sched->connections[conn_nr];
+    memset(conn, 0, sizeof(connection));
+    memcpy(conn->identity, identity, identity_len);
+    conn->identity_len = identity_len;
+    strncpy(conn->host_name, host, ENDPOINT_LEN-1);
+    conn->credits = (unsigned int) credits;
+    conn->max_credits = (unsigned int) credits;
+
+    for(long i=0; i<credits; i++){
+        worker_slot *worker = add_worker_slot(sched, host, (double) threads / credits);
+        snprintf(worker->endpoint, ENDPOINT_LEN, "%.200s#%zu", worker->host_name, sched->amount_of_workers-1);
+        worker->registered = true;
+        worker->connection = conn_nr;
+    }
+    fprintf(stderr, "Worker %s registered with %ld threads and %ld credits.\n", host, threads, credits);
+}
+
+// "bye": the worker doesn't get any new tasks, it's removed once its running tasks are done (see send_departures)
+static void unregister_worker(scheduler *sched, size_t conn_nr){
+    sched->connections[conn_nr].leaving = true;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!worker->registered || worker->connection != conn_nr || !accepts_tasks(worker))
+            continue;
+
+        worker->leaving = true;
+        sched->amount_of_live_workers--;
+    }
+}
+
+// sends RIP to leaving workers whose threads are all idle
+static void send_departures(scheduler *sched){
+    char rip[4] = {0};
+    encode_msg(rip, "", RIP);
+
+    for(size_t i=0; i<sched->amount_of_connections; i++){
+        connection *conn = &sched->connections[i];
+        if(!conn->leaving || conn->gone)
+            continue;
+
+        bool idle = true;
+        for(size_t j=0; j<sched->amount_of_workers; j++){
+            if(sched->workers[j].registered && sched->workers[j].connection == i && sched->workers[j].busy)
+                idle = false;
+        }
+        if(!idle)
+            continue;
+
+        fprintf(stderr, "Worker %s left.\n", conn->host_name);
+        send_routed(sched, conn, rip, sizeof(rip));
+        remove_registered_worker(sched, i);
+    }
+}
+
+// receives one message from the ROUTER socket and handles registrations and credits
+// returns the slot that answered a task (the result is in reply) or -1 if the message wasn't an expected reply
+// *type is set to the type of the message (EMPTY for replies)
+static int receive_routed(scheduler *sched, worker_reply *reply, MSG_TYPE *type){
+    char identity[IDENTITY_LEN];
+    char first[MSG_LEN];        // control message or task id
+    int first_size = 0;
+    int amount_of_frames = 0;
+
+    int identity_len = zmq_recv(sched->router, identity, IDENTITY_LEN, 0);
+    if(identity_len < 0){
+        fprintf(stderr, "Could not receive from router: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    // read all frames of the message, even if there are too many
+    int more = 1;
+    size_t more_size = sizeof(more);
+    zmq_getsockopt(sched->router, ZMQ_RCVMORE, &more, &more_size);
+    while(more){
+        if(amount_of_frames == 0){
+            first_size = zmq_recv(sched->router, first, MSG_LEN-1, 0);
+            if(first_size < 0)
+                break;
+            if(first_size > MSG_LEN-1)
+                first_size = MSG_LEN-1;
+            first[first_size] = '\0';
+        }
+        else{
+            // the result frame stays in the message, everything behind it is dropped
+            zmq_msg_t *frame = &reply->msg;
+            zmq_msg_t discard;
+            if(amount_of_frames > 1){
+                zmq_msg_init(&discard);
+                frame = &discard;
+            }
+            if(zmq_msg_recv(frame, sched->router, 0) < 0)
+                break;
+            if(frame == &discard)
+                zmq_msg_close(&discard);
+        }
+        amount_of_frames++;
+        zmq_getsockopt(sched->router, ZMQ_RCVMORE, &more, &more_size);
+    }
+
+    *type = INVALID;
+    int conn_nr = find_connection(sched, identity, identity_len);
+    if(amount_of_frames == 1){
+        char payload[MSG_LEN] = {0};
+        *type = decode_msg(first, payload);
+        if(*type == HEY)
+            register_worker(sched, identity, identity_len, payload);
+        else if(*type == BYE && conn_nr != -1)
+            unregister_worker(sched, conn_nr);
+        return -1;
+    }
+    if(amount_of_frames != 2 || conn_nr == -1)
+        return -1;
+
+    // every answer (even a late or rejected one) gives the credit of its task back
+    connection *conn = &sched->connections[conn_nr];
+    if(conn->credits < conn->max_credits)
+        conn->credits++;
+
+    // [task id][result] -> find the slot of the worker that works on this task
+    *type = EMPTY;
+    unsigned long task_id = strtoul(first, NULL, 10);
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!worker->registered || worker->connection != (size_t) conn_nr || !worker->busy || worker->task_id != task_id)
+            continue;
+
+        // [task id][] -> the worker's buffer was full, the task goes back into the queue
+        if(zmq_msg_size(&reply->msg) == 0){
+            *type = INVALID;
+            requeue_request(sched, (int) i, false);
+            return -1;
+        }
+        msg_view view = decode_msg_view_from_worker((const char *) zmq_msg_data(&reply->msg), zmq_msg_size(&reply->msg));
+        reply->payload = view.payload;
+        reply->len = view.len;
+        take_known_words(worker, reply);
+        return (int) i;
+    }
+    return -1;      // answer to a request that already timed out
+}
+
+// removes the worker from the rotation, it won't get any more tasks
+static void evict_worker(scheduler *sched, int worker_nr){
+    worker_slot *worker = &sched->workers[worker_nr];
+    fprintf(stderr, "Evicting worker %s after %u failed requests.\n", worker->endpoint, worker->failures);
+
+    if(worker->socket)
+        zmq_close(worker->socket);
+    if(worker->channel)
+        shm_channel_close(worker->channel);
+    worker->socket = NULL;
+    worker->channel = NULL;
+    worker->busy = false;
+    if(!worker->leaving)
+        sched->amount_of_live_workers--;
+    worker->evicted = true;
+
+    // new workers might still register
+    if(sched->amount_of_live_workers == 0 && !sched->router){
+        fprintf(stderr, "All workers have been evicted, giving up.\n");
+        exit(1);
+    }
+}
+
+// Lazy Pirate: a request timed out -> reset the socket and hand the task to the next free worker
+// registered workers don't need a reset, a late reply is just discarded (and gives the credit back)
+static void handle_timeout(scheduler *sched, int worker_nr){
+    worker_slot *worker = &sched->workers[worker_nr];
+    assert(worker->busy);
+
+    worker->failures++;
+    fprintf(stderr, "Request to %s timed out (%u in a row).\n", worker->endpoint, worker->failures);
+    requeue_request(sched, worker_nr, true);
+
+    if(worker->failures >= MAX_WORKER_FAILURES){
+        evict_worker(sched, worker_nr);
+    }
+    else if(!worker->registered){
+        zmq_close(worker->socket);
+        connect_worker(sched, worker);
+    }
+}
+
+
+// amount of busy workers on the given host
+static size_t host_load(scheduler *sched, size_t host){
+    size_t load = 0;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        if(sched->workers[i].host == host && sched->workers[i].busy)
+            load++;
+    }
+    return load;
+}
+
+// smooth weighted round robin (like nginx does it): every live worker gains its weight, the one with
+// the highest current weight is next and loses the total weight once it got its task (or has been skipped)
+// with equal weights this is a plain round robin, ties go to the worker whose host is the least busy
+static int peek_rotation(scheduler *sched){
+    int best = -1;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!accepts_tasks(worker))
+            continue;
+        if(best == -1){
+            best = (int) i;
+            continue;
+        }
+
+        double difference = (worker->current_weight + worker->weight) - (sched->workers[best].current_weight + sched->workers[best].weight);
+        if(difference > 1e-9 || (difference > -1e-9 && host_load(sched, worker->host) < host_load(sched, sched->workers[best].host)))
+            best = (int) i;
+    }
+    return best;
+}
+
+// moves the rotation on, after the given worker got its turn
+static int rotate(scheduler *sched, int worker_nr){
+    double total_weight = 0;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!accepts_tasks(worker))
+            continue;
+        worker->current_weight += worker->weight;
+        total_weight += worker->weight;
+    }
+    sched->workers[worker_nr].current_weight -= total_weight;
+    return worker_nr;
+}
+
+// returns the index of the next worker in the rotation, that can take a task, or -1 if there is none
+// a busy worker blocks the rotation (this keeps the load distribution fair), unless it is a straggler or unreliable
+// (compared to the other tasks of its phase), *timeout is lowered to the time in ms until the blocking worker becomes a straggler
+static int next_idle_worker(scheduler *sched, long *timeout){
+    double now = now_ms();
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        int worker_nr = peek_rotation(sched);
+        if(worker_nr == -1)
+            return -1;      // no live workers (yet)
+        worker_slot *worker = &sched->workers[worker_nr];
+
+        // a worker without credit doesn't hold up the rotation, its buffer is full of timed out tasks
+        if(!has_credit(sched, worker)){
+            rotate(sched, worker_nr);
+            continue;
+        }
+
+        if(!worker->busy)
+            return rotate(sched, worker_nr);
+
+        // workers that recently timed out or still work on a discarded copy (of the last phase) aren't worth waiting for
+        running_task *task = find_running_task(sched, worker->task_id, NULL);
+        if(worker->failures > 0 || !task){
+            rotate(sched, worker_nr);
+            continue;
+        }
+
+        double threshold = straggler_threshold(&task->phase->durations);
+        double elapsed = now - worker->sent_at;
+        if(threshold < 0 || elapsed < threshold){
+            long remaining = threshold < 0 ? -1 : (long)(threshold - elapsed) + 1;
+            if(remaining >= 0 && (*timeout < 0 || remaining < *timeout))
+                *timeout = remaining;
+            return -1;
+        }
+
+        rotate(sched, worker_nr);      // straggler -> skip it
+    }
+    return -1;
+}
+
+// returns true if a copy of the task is running on the given host
+static bool task_runs_on_host(scheduler *sched, running_task *task, size_t host){
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(worker->busy && worker->task_id == task->id && worker->host == host)
+            return true;
+    }
+    return false;
+}
+
+// returns the idle worker that should get a copy of the task or -1 if all of them are busy
+// workers on another host than the straggling one are preferred (its host might just be overloaded), then higher weights
+static int idle_worker_for_copy(scheduler *sched, running_task *task){
+    int best = -1;
+    bool best_other_host = false;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!accepts_tasks(worker) || worker->busy || !has_credit(sched, worker))
+            continue;
+
+        bool other_host = !task_runs_on_host(sched, task, worker->host);
+        if(best == -1 || (other_host && !best_other_host) ||
+           (other_host == best_other_host && worker->weight > sched->workers[best].weight)){
+            best = (int) i;
+            best_other_host = other_host;
+        }
+    }
+    return best;
+}
+
+// hands copies of the slowest running tasks to idle workers, only the tasks of phases whose input is finished are copied
+// *timeout is lowered to the time in ms until the next task becomes a straggler
+static void speculate(scheduler *sched, long *timeout){
+    while(true){
+        double now = now_ms();
+
+        // find the task that has been running for the longest time (relative to the other tasks of its phase) and may still be copied
+        running_task *slowest = NULL;
+        double threshold = -1;
+        struct list_node *curr = sched->running_tasks->first;
+        while(curr){
+            running_task *task = (running_task *) curr->data;
+            double task_threshold = straggler_threshold(&task->phase->durations);
+            if(task->copies < MAX_TASK_COPIES && task_threshold >= 0 && chunker_is_finished(task->phase->input) &&
+               (!slowest || task->started_at + task_threshold < slowest->started_at + threshold)){
+                slowest = task;
+                threshold = task_threshold;
+            }
+            curr = curr->next;
+        }
+
+        if(!slowest)
+            return;
+
+        double elapsed = now - slowest->started_at;
+        if(elapsed < threshold){
+            long remaining = (long)(threshold - elapsed) + 1;
+            if(*timeout < 0 || remaining < *timeout)
+                *timeout = remaining;
+            return;
+        }
+
+        int worker_nr = idle_worker_for_copy(sched, slowest);
+        if(worker_nr == -1)
+            return;
+        send_task(sched, worker_nr, slowest);     // if the worker is gone, the next idle one is tried
+    }
+}
+
+// returns the size of the next task for the given worker
+static size_t task_size(scheduler *sched, int worker_nr, chunker *input){
+    // throughput per weight, a worker that is as fast as its weight suggests is at the top
+    double fastest = 0;
+    double total_weight = 0;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!accepts_tasks(worker))
+            continue;
+        total_weight += worker->weight;
+        if(worker->rate / worker->weight > fastest)
+            fastest = worker->rate / worker->weight;
+    }
+
+    // workers that are slower than their weight suggests get smaller tasks, so that every task takes about the same time
+    worker_slot *worker = &sched->workers[worker_nr];
+    size_t size = MAX_CHUNK_LEN;
+    double rate = worker->rate / worker->weight;
+    if(rate > 0 && rate < RATE_TOLERANCE * fastest)
+        size = (size_t)(MAX_CHUNK_LEN * rate / fastest);
+
+    // end of the phase: split what's left according to the weights, so no worker is busy with a big task while the others are idle
+    unsigned long long remaining = chunker_remaining(input);
+    unsigned long long tail = (unsigned long long) TAIL_ROUNDS * sched->amount_of_live_workers * MAX_CHUNK_LEN;
+    if(remaining < tail){
+        size_t share = (size_t)(remaining * worker->weight / (TAIL_ROUNDS * total_weight));
+        if(share < size)
+            size = share;
+    }
+
+    if(size < MIN_TASK_LEN)
+        size = MIN_TASK_LEN;
+    return size;
+}
+
+// bookkeeping of a task whose first reply arrived, the result goes to the handler of its phase
+static void finish_task(scheduler *sched, running_task *task, size_t index, worker_reply *reply){
+    scheduler_phase *phase = task->phase;
+    duration_list_add(&phase->durations, now_ms() - task->started_at);
+    if(task->cacheable)
+        chunk_cache_put(sched->cache, task->key, reply->payload, reply->len);
+    if(phase->command == MAP_IDS)
+        word_dictionary_observe(sched->dictionary, reply->payload, reply->len);
+
+    running_task done;
+    list_remove_node(sched->running_tasks, index, &done);
+    free_task(&done);
+
+    phase->running--;
+    phase->handle_result(reply->payload, reply->len, phase->arg);
+}
+
+// returns true if there is a message waiting on the socket
+static bool can_receive(void *socket){
+    int events = 0;
+    size_t events_size = sizeof(events);
+    if(zmq_getsockopt(socket, ZMQ_EVENTS, &events, &events_size) != 0)
+        return false;
+    return events & ZMQ_POLLIN;
+}
+
+void scheduler_phase_init(scheduler_phase *phase, chunker *input, MSG_TYPE command, double weight,
+                          void (*handle_result)(const char *result, size_t len, void *arg), void *arg){
+    assert(phase);
+    assert(input);
+    assert(handle_result);
+    assert(weight > 0);
+
+    memset(phase, 0, sizeof(scheduler_phase));
+    phase->input = input;
+    phase->command = command;
+    phase->weight = weight;
+    phase->handle_result = handle_result;
+    phase->arg = arg;
+}
+
+bool scheduler_phase_is_done(scheduler_phase *phase){
+    assert(phase);
+    return phase->failed || (phase->running == 0 && chunker_is_finished(phase->input));
+}
+
+void scheduler_phase_destroy(scheduler_phase *phase){
+    assert(phase);
+    free(phase->durations.values);
+    memset(&phase->durations, 0, sizeof(duration_list));
+}
+
+// deficit round robin: returns the phase that may cut the next task or NULL if none of them has a chunk ready
+// a phase keeps its turn while it has deficit left, then the next one gets its quantum (weight * MAX_CHUNK_LEN)
+// phases without a chunk ready lose their deficit, so they can't save up for a burst later on
+static scheduler_phase* next_phase(scheduler *sched, scheduler_phase *phases[], size_t amount_of_phases){
+    bool ready = false;
+    for(size_t i=0; i<amount_of_phases; i++){
+        if(!phases[i]->failed && chunker_has_next(phases[i]->input))
+            ready = true;
+        else
+            phases[i]->deficit = 0;
+    }
+    if(!ready)
+        return NULL;
+
+    while(true){
+        scheduler_phase *phase = phases[sched->next_phase % amount_of_phases];
+        if(!phase->failed && chunker_has_next(phase->input)){
+            if(phase->deficit <= 0)
+                phase->deficit += phase->weight * MAX_CHUNK_LEN;
+            if(phase->deficit > 0)
+                return phase;
+        }
+        sched->next_phase = (sched->next_phase + 1) % amount_of_phases;
+    }
+}
+
+// cuts the next task of the phase (max_len bytes at most)
+static void cut_task(scheduler *sched, scheduler_phase *phase, size_t max_len, running_task *task){
+    chunker *input = phase->input;
+
+    // cached chunks have to be cut the same way every time
+    task->cacheable = sched->cache && phase->command == MAP;
+    if(task->cacheable){
+        chunker_set_content_defined(input, true);
+        max_len = MAX_CHUNK_LEN;
+    }
+    // MAP_IDS tasks leave room for the update of the worker's dictionary, a long word leaves less room, but never less
+    // than the smallest update
+    if(phase->command == MAP_IDS){
+        chunker_set_split_len(input, MAX_CHUNK_LEN - 2 * VARINT_LEN);
+        if(max_len > MAX_CHUNK_LEN - DICTIONARY_UPDATE_LEN)
+            max_len = MAX_CHUNK_LEN - DICTIONARY_UPDATE_LEN;
+    }
+    // a MAP_COMBINED result is as long as its chunk + 1 if the chunk is a single (long) word, its count mustn't be cut off
+    // by the chunker of the RED phase (a word without count can't be merged), so the chunk is a byte shorter than that
+    if(phase->command == MAP_COMBINED){
+        chunker_set_split_len(input, MAX_CHUNK_LEN - 1);
+        if(max_len > MAX_CHUNK_LEN - 1)
+            max_len = MAX_CHUNK_LEN - 1;
+    }
+
+    // mapped input -> the task just points into it
+    task->mapping = NULL;
+    task->owned = NULL;
+    if(chunker_is_mapped(input)){
+        // the view may move on to the next segment, so the mapping is taken afterwards
+        task->len = chunker_next_view(input, &task->data, max_len);
+        task->mapping = chunker_retain(chunker_mapping(input));
+    }
+    else{
+        task->owned = (char *) malloc(MAX_CHUNK_LEN + 1);
+        if(!task->owned){
+            fprintf(stderr, "Could not allocate task.\n");
+            exit(1);
+        }
+        task->len = chunker_next(input, task->owned, max_len);
+        task->data = task->owned;
+    }
+    task->id = sched->next_task_id++;
+    task->attempts = 0;
+    task->phase = phase;
+    phase->running++;
+    if(task->cacheable)
+        task->key = chunk_cache_key(task->data, task->len, phase->command);
+
+    // the turn moves on once the phase used up its quantum
+    phase->deficit -= task->len;
+    if(phase->deficit <= 0)
+        sched->next_phase++;
+}
+
+// hands the cached result of a task that has just been cut to its phase, returns false if the chunk isn't cached
+static bool serve_from_cache(scheduler *sched, running_task *task){
+    size_t len = 0;
+    char *result = chunk_cache_get(sched->cache, task->key, task->len, &len);
+    if(!result)
+        return false;
+
+    task->phase->running--;
+    task->phase->handle_result(result, len, task->phase->arg);
+    free(result);
+    free_task(task);
+    return true;
+}
+
+void scheduler_step(scheduler *sched, scheduler_phase *phases[], size_t amount_of_phases, void *wake_socket){
+    assert(sched);
+    assert(phases || amount_of_phases == 0);
+
+    worker_reply reply;
+    long timeout = -1;
+
+    // hand out queued tasks round robin (failed ones first), the phases take turns
+    while(true){
+        int worker_nr = -1;
+        scheduler_phase *phase = NULL;
+        if(list_is_empty(sched->retry_queue)){
+            phase = next_phase(sched, phases, amount_of_phases);
+            if(!phase)
+                break;
+
+            // cached chunks don't need a worker, the other ones wait in the queue for the next idle one
+            if(sched->cache && phase->command == MAP){
+                running_task task;
+                cut_task(sched, phase, MAX_CHUNK_LEN, &task);
+                if(!serve_from_cache(sched, &task))
+                    list_insert_back(sched->retry_queue, &task);
+                continue;
+            }
+        }
+        worker_nr = next_idle_worker(sched, &timeout);
+        if(worker_nr == -1)
+            break;
+
+        running_task task;
+        if(!phase)
+            list_remove_front(sched->retry_queue, &task);
+        else
+            cut_task(sched, phase, task_size(sched, worker_nr, phase->input), &task);
+        task.started_at = now_ms();
+        task.copies = 0;
+
+        // the worker is gone -> the task goes to the next one
+        if(!send_task(sched, worker_nr, &task)){
+            list_insert_front(sched->retry_queue, &task);
+            continue;
+        }
+        list_insert_back(sched->running_tasks, &task);
+    }
+
+    // queue drained -> idle workers help out with the stragglers
+    // the readers haven't got the next chunk of a phase yet (a slow stream) -> check again soon
+    bool drained = list_is_empty(sched->retry_queue);
+    bool waiting_for_input = false;
+    for(size_t i=0; i<amount_of_phases; i++){
+        if(phases[i]->failed)
+            continue;
+        if(chunker_has_next(phases[i]->input))
+            drained = false;
+        else if(!chunker_is_finished(phases[i]->input))
+            waiting_for_input = true;
+    }
+    if(drained)
+        speculate(sched, &timeout);
+    if(waiting_for_input && (timeout < 0 || timeout > INPUT_WAIT_MS))
+        timeout = INPUT_WAIT_MS;
+
+    // a phase can be done without a single reply (all of its chunks were cached), then the caller moves on right away
+    for(size_t i=0; i<amount_of_phases; i++){
+        if(scheduler_phase_is_done(phases[i]))
+            timeout = 0;
+    }
+
+    // the workers might have moved (registrations), so the poll items are rebuilt every round
+    if(sched->items_capacity < sched->amount_of_workers + 2){
+        sched->items_capacity = sched->amount_of_workers + 2;
+        sched->items = (zmq_pollitem_t *) realloc(sched->items, sched->items_capacity * sizeof(zmq_pollitem_t));
+        sched->item_workers = (int *) realloc(sched->item_workers, sched->items_capacity * sizeof(int));
+        if(!sched->items || !sched->item_workers){
+            fprintf(stderr, "Could not allocate poll items.\n");
+            exit(1);
+        }
+    }
+    zmq_pollitem_t *items = sched->items;
+    int *item_workers = sched->item_workers;
+
+    // wait for any busy worker to reply (or a worker to register), but not longer than the first request takes to time out
+    double now = now_ms();
+    int amount_of_items = 0;
+    if(wake_socket){
+        items[amount_of_items] = (zmq_pollitem_t){wake_socket, 0, ZMQ_POLLIN, 0};
+        item_workers[amount_of_items] = -2;
+        amount_of_items++;
+    }
+    if(sched->router){
+        items[amount_of_items] = (zmq_pollitem_t){sched->router, 0, ZMQ_POLLIN, 0};
+        item_workers[amount_of_items] = -1;
+        amount_of_items++;
+    }
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        if(!sched->workers[i].busy)
+            continue;
+
+        long remaining = (long)(sched->workers[i].sent_at + sched->request_timeout - now) + 1;
+        if(remaining < 0)
+            remaining = 0;
+        if(timeout < 0 || remaining < timeout)
+            timeout = remaining;
+
+        if(sched->workers[i].registered)
+            continue;       // replies arrive at the router
+        items[amount_of_items] = (zmq_pollitem_t){sched->workers[i].socket, 0, ZMQ_POLLIN, 0};
+        item_workers[amount_of_items] = (int) i;
+        amount_of_items++;
+    }
+    assert(amount_of_items > 0 || timeout >= 0);
+
+    if(zmq_poll(items, amount_of_items, timeout) < 0 && zmq_errno() != EINTR){
+        fprintf(stderr, "Polling workers failed: %s\n", zmq_strerror(zmq_errno()));
+        exit(1);
+    }
+
+    for(int i=0; i<amount_of_items; i++){
+        if(!(items[i].revents & ZMQ_POLLIN) || item_workers[i] == -2)
+            continue;       // the wake socket is up to the caller
+
+        size_t index = 0;
+        running_task *task = NULL;
+        if(item_workers[i] != -1){
+            reply_init(&reply);
+            task = receive_reply(sched, item_workers[i], &reply, &index);
+            if(task)
+                finish_task(sched, task, index, &reply);
+            reply_close(&reply);
+            continue;   // NULL: late copy of an already answered task -> discard
+        }
+
+        // drain the router, registrations are handled on the way
+        while(can_receive(sched->router)){
+            MSG_TYPE type;
+            reply_init(&reply);
+            int worker_nr = receive_routed(sched, &reply, &type);
+            if(worker_nr != -1){
+                task = complete_request(sched, worker_nr, &index);
+                if(task)
+                    finish_task(sched, task, index, &reply);
+            }
+            reply_close(&reply);
+        }
+    }
+
+    now = now_ms();
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        if(sched->workers[i].busy && now - sched->workers[i].sent_at >= sched->request_timeout)
+            handle_timeout(sched, (int) i);
+    }
+
+    if(sched->router)
+        send_departures(sched);
+}
+
+int scheduler_run_phase(scheduler *sched, chunker *input, MSG_TYPE command,
+                        void (*handle_result)(const char *result, size_t len, void *arg), void *arg){
+    assert(sched);
+
+    scheduler_phase phase;
+    scheduler_phase_init(&phase, input, command, 1, handle_result, arg);
+    scheduler_phase *phases[1] = {&phase};
+    while(!scheduler_phase_is_done(&phase))
+        scheduler_step(sched, phases, 1, NULL);
+
+    scheduler_phase_destroy(&phase);
+    return phase.failed;
+}
+
+// waits until the socket has a message or the deadline passed, returns true if there is one
+static bool wait_for_reply(void *socket, double deadline){
+    long timeout = (long)(deadline - now_ms());
+    if(timeout < 0)
+        timeout = 0;
+
+    zmq_pollitem_t item = {socket, 0, ZMQ_POLLIN, 0};
+    if(zmq_poll(&item, 1, timeout) < 0)
+        return false;
+    return item.revents & ZMQ_POLLIN;
+}
+
+// sends RIP to every registered worker that hasn't got one yet, returns the amount of RIPs sent
+static size_t kill_registered_workers(scheduler *sched, char rip[]){
+    size_t sent = 0;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(!worker->registered || worker->evicted)
+            continue;
+
+        if(send_routed(sched, &sched->connections[worker->connection], rip, strlen(rip)+1) == 0)
+            sent++;
+        remove_registered_worker(sched, worker->connection);
+    }
+    return sent;
+}
+
+void scheduler_kill_workers(scheduler *sched){
+    assert(sched);
+    double deadline = now_ms() + sched->request_timeout;
+
+    // workers that still work on a discarded copy have to answer before they can receive RIP (REQ socket)
+    // the ones that don't answer in time are considered dead and don't get a RIP
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(worker->evicted || worker->registered || !worker->busy)
+            continue;
+
+        if(wait_for_reply(worker->socket, deadline)){
+            worker_reply reply;
+            reply_init(&reply);
+            receive_reply(sched, (int) i, &reply, NULL);
+            reply_close(&reply);
+        }
+    }
+
+    char buffer[MSG_LEN] = {0};
+    if(encode_msg_to_worker(buffer, "", RIP) != 0){
+        fprintf(stderr, "Could not encode message.\n\n");
+        exit(1);
+    }
+
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(worker->evicted || worker->registered || worker->busy)
+            continue;
+        zmq_send(worker->socket, buffer, strlen(buffer)+1, 0);
+    }
+
+    // registered workers get a single RIP for all of their threads (the ones with running tasks finish them first)
+    size_t missing_acks = 0;
+    if(sched->router)
+        missing_acks = kill_registered_workers(sched, buffer);
+
+    deadline = now_ms() + sched->request_timeout;
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        worker_slot *worker = &sched->workers[i];
+        if(worker->evicted || worker->registered || worker->busy)
+            continue;
+
+        if(wait_for_reply(worker->socket, deadline)){
+            char reply[MSG_LEN];
+            zmq_recv(worker->socket, reply, MSG_LEN, 0);
+        }
+        else{
+            fprintf(stderr, "Worker %s did not acknowledge RIP.\n", worker->endpoint);
+        }
+    }
+
+    // late replies are dropped, workers that register now are sent home right away
+    while(missing_acks > 0 && wait_for_reply(sched->router, deadline)){
+        worker_reply reply;
+        MSG_TYPE type;
+        reply_init(&reply);
+        receive_routed(sched, &reply, &type);
+        reply_close(&reply);
+        if(type == RIP)
+            missing_acks--;
+        missing_acks += kill_registered_workers(sched, buffer);
+    }
+    if(missing_acks > 0)
+        fprintf(stderr, "%zu registered workers did not acknowledge RIP.\n", missing_acks);
+}
+
+void scheduler_destroy(scheduler *sched){
+    assert(sched);
+    for(size_t i=0; i<sched->amount_of_workers; i++){
+        if(sched->workers[i].socket)
+            zmq_close(sched->workers[i].socket);
+        if(sched->workers[i].channel)
+            shm_channel_close(sched->workers[i].channel);
+    }
+    if(sched->router)
+        zmq_close(sched->router);
+
+    list_destroy(sched->running_tasks);
+    list_destroy(sched->retry_queue);
+    free(sched->items);
+    free(sched->item_workers);
+    free(sched->connections);
+    free(sched->workers);
+    free(sched);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+// This header houses the scheduler of the distributor
+// it keeps one connection per worker open and hands out the tasks of one or more phases at once, the workers are either
+// given on the command line or register themselves (see connection)
+#include <zmq.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../lib/encoder.h"
+#include "../lib/linked_list.h"
+#include "../lib/shm_ring.h"
+#include "../lib/word_ids.h"
+#include "./chunker.h"
+#include "./chunk_cache.h"
+
+#define ENDPOINT_LEN 256
+// zmq routing ids are at most 255 bytes
+#define IDENTITY_LEN 256
+// a request that hasn't been answered after this many ms counts as failed (unless the scheduler is told otherwise)
+#define DEFAULT_REQUEST_TIMEOUT_MS 2500
+// bytes of a MAP_IDS task that are kept for the update of the worker's dictionary: every MAP_IDS task starts with the
+// words of the dictionary the worker hasn't got yet (as many as fit), the reply tells how many words it knows and the words
+// of the MAP results that turn out to be frequent get an ID (see word_ids.h)
+#define DICTIONARY_UPDATE_LEN 256
+
+// worker as given on the command line (e.g. "5555", "5555:4", "node2:5555", "ipc:///tmp/worker0", "shm://worker0")
+// workers on the same machine can be reached through shared memory (shm://<name>), then the chunks and results are
+// written into a shm_channel and the REQ socket only carries the task id as notification
+typedef struct{
+    char endpoint[ENDPOINT_LEN];    // zmq endpoint the distributor connects to
+    char host[ENDPOINT_LEN];        // machine the worker runs on (ipc and inproc workers are local)
+    double weight;                  // capacity relative to the other workers (default 1)
+}worker_spec;
+
+// a worker that registered at the router, all of its slots share the connection
+// if the distributor listens on a ROUTER socket, workers can connect themselves (with a DEALER socket) and register/ leave
+// at any time, even in the middle of a phase:
+//  worker -> distributor: "hey<threads> <host> <credits>", "bye" or [task id][result]
+//  distributor -> worker: [task id]["map"/"red"][chunk] or "rip"
+// the chunk frame of a mapped input points right into the mapping (zero copy), it isn't NUL terminated
+// flow control is credit based: every task that is sent costs a credit and every reply gives one back (even late ones),
+// so neither the queue of a slow worker nor the replies in flight can grow beyond max_credits, while the worker has its
+// next tasks already buffered, a worker that gets a task without credit rejects it with [task id][] and it's requeued
+typedef struct{
+    char identity[IDENTITY_LEN];    // routing id
+    size_t identity_len;
+    char host_name[ENDPOINT_LEN];
+    unsigned int credits;           // tasks that can still be sent to the worker
+    unsigned int max_credits;       // tasks the worker can buffer (including the ones its threads work on)
+    bool leaving;                   // said bye
+    bool gone;                      // got its RIP or is unreachable
+    size_t known_words;             // words of the dictionary that have been sent to it (it gets its tasks in order)
+}connection;
+
+typedef struct{
+    char endpoint[ENDPOINT_LEN];    // for registered workers this is "<host>#<slot>"
+    size_t host;                // index of the host, workers with the same index run on the same machine
+    char host_name[ENDPOINT_LEN];
+    double weight;              // share of the tasks the worker gets, relative to the other workers
+    double current_weight;      // state of the smooth weighted round robin
+    void *socket;               // REQ socket, stays connected for all phases (NULL for registered workers)
+    shm_channel *channel;       // shared memory of shm:// workers (NULL for all others)
+    bool registered;            // worker connected itself, it is reached through the ROUTER socket
+    size_t connection;          // index of its connection (registered workers have one slot per credit)
+    bool leaving;               // registered worker said bye, it finishes its task, but doesn't get a new one
+    bool busy;                  // a request has been sent and the reply is still missing
+    unsigned long task_id;      // id of the task the worker is currently working on
+    MSG_TYPE command;           // of the current task
+    size_t known_words;         // words of the dictionary the worker has got (as of its last reply, see connection otherwise)
+    double sent_at;             // ms, time the current request has been sent
+    size_t sent_bytes;          // size of the current task
+    double rate;                // bytes/ms, moving average of the measured throughput (0 if nothing measured yet)
+    unsigned int failures;      // consecutive requests that timed out
+    bool evicted;               // worker failed too often (or left) and doesn't get any more tasks
+}worker_slot;
+
+// durations of all finished tasks of a phase (used for the median)
+typedef struct{
+    double *values;
+    size_t amount;
+    size_t capacity;
+    double median;              // cached, see duration_list_median
+    size_t median_amount;       // amount of values the cached median has been computed with
+}duration_list;
+
+// one phase of a job (MAP or RED of one input), several phases can run at once and share the workers
+// they take turns by deficit round robin: a phase that has a chunk ready gets weight * MAX_CHUNK_LEN bytes per round,
+// so a small phase is done after a round or two, while a big one gets whatever the others leave
+typedef struct{
+    chunker *input;
+    MSG_TYPE command;
+    void (*handle_result)(const char *result, size_t len, void *arg);
+    void *arg;
+    double weight;              // share of the workers relative to the other phases (priority), default 1
+    double deficit;             // bytes the phase may still hand out in the current round
+    size_t running;             // tasks that have been cut, but haven't been answered yet (including the ones to retry)
+    bool failed;                // a task of the phase failed too often, the rest of the phase has been given up
+    duration_list durations;    // of the finished tasks, stragglers are measured against them
+}scheduler_phase;
+
+typedef struct{
+    void *context;
+    void *router;                       // ROUTER socket workers register at (NULL if the distributor doesn't listen)
+    worker_slot *workers;
+    size_t amount_of_workers;
+    size_t capacity;                    // allocated worker slots
+    connection *connections;            // workers that registered at the router
+    size_t amount_of_connections;
+    size_t connections_capacity;
+    size_t amount_of_live_workers;      // workers that haven't been evicted and aren't leaving
+    size_t amount_of_hosts;
+    list_head *running_tasks;           // tasks that have been sent, but haven't been answered yet
+    list_head *retry_queue;             // tasks that wait for a worker (timed out or not cached), these are handed out before new ones
+    unsigned long next_task_id;
+    size_t next_phase;                  // phase whose turn it is (deficit round robin)
+    chunk_cache *cache;                 // results of MAP chunks that don't have to be sent again (NULL if there is no cache)
+    word_dictionary *dictionary;        // IDs of the frequent words for MAP_IDS/ RED_IDS tasks (NULL if there is none)
+    double request_timeout;             // ms after which an unanswered request counts as failed
+    zmq_pollitem_t *items;              // poll items of scheduler_step (reused)
+    int *item_workers;                  // worker of each poll item (-1 for the router, -2 for the wake socket)
+    size_t items_capacity;
+}scheduler;
+
+// listen_endpoint is the endpoint workers can register at (NULL if there is none, then there must be at least one spec)
+scheduler* scheduler_init(void *context, worker_spec specs[], size_t amount_of_workers, const char *listen_endpoint);
+// handle_result is called once per task with the payload of the (first) reply (len bytes, not necessarily NUL terminated)
+void scheduler_phase_init(scheduler_phase *phase, chunker *input, MSG_TYPE command, double weight,
+                          void (*handle_result)(const char *result, size_t len, void *arg), void *arg);
+// returns true if every task of the phase has been answered and its input is finished, or if the phase failed
+bool scheduler_phase_is_done(scheduler_phase *phase);
+// frees the durations, the input isn't destroyed
+void scheduler_phase_destroy(scheduler_phase *phase);
+// one round: hands out the tasks of all phases that can be cut right now (failed ones first), then waits for replies and
+// registrations until there is something to do again or wake_socket (may be NULL) becomes readable, the phases may change
+// from one call to the next, but a phase must be kept until it's done
+// the workers get their tasks (weighted) round robin, consecutive tasks are spread across hosts (they share a machine's
+// resources), and a worker that takes way longer than the other ones (straggler) is skipped instead of holding up the rotation
+// the size of a task is chosen on dispatch: workers that are slower than their weight suggests get smaller tasks and the
+// tasks shrink at the end of a phase, once nothing is queued anymore idle workers get copies of straggling tasks (first
+// reply wins, the other one is discarded)
+// MAP chunks that are in the cache are handled right away instead of being sent (they are content defined then and
+// don't adapt their size)
+// requests that time out (sched->request_timeout) are handed to another worker and a worker that keeps failing is evicted
+// (Lazy Pirate pattern), a task that fails too often fails its phase (see scheduler_phase.failed), the other phases go on
+// exits if every worker has been evicted (unless new workers can still register)
+void scheduler_step(scheduler *sched, scheduler_phase *phases[], size_t amount_of_phases, void *wake_socket);
+// cuts the input into tasks as it becomes available and sends them with the given command to the workers
+// until the input is finished (or its deadline is over, see chunker_set_deadline)
+// handle_result is called once per task with the payload of the (first) reply (len bytes, not necessarily NUL terminated)
+// returns 0 on success, 1 if a task failed too often (the rest of the input is left), when this returns the input is done
+// exits if every worker has been evicted (unless new workers can still register)
+int scheduler_run_phase(scheduler *sched, chunker *input, MSG_TYPE command,
+                        void (*handle_result)(const char *result, size_t len, void *arg), void *arg);
+// sends RIP to all workers (registered ones once per connection) and waits for their replies
+void scheduler_kill_workers(scheduler *sched);
+void scheduler_destroy(scheduler *sched);
@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "./window.h"
+
+word_window* window_init(size_t panes_per_window, size_t top){
+    assert(panes_per_window > 0);
+    assert(top > 0);
+
+    word_window *window = (word_window *) calloc(1, sizeof(word_window));
+    if(!window){
+        fprintf(stderr, "Could not allocate window.\n");
+        exit(1);
+    }
+    window->totals = hashmap_init(1024, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    window->panes = list_init(sizeof(hashmap *));
+    window->panes_per_window = panes_per_window;
+    window->top_capacity = top;
+    window->top = (window_entry *) calloc(top, sizeof(window_entry));
+    if(!window->top){
+        fprintf(stderr, "Could not allocate window.\n");
+        exit(1);
+    }
+    return window;
+}
+
+// helper for window_add_pane, adds the count of one word of a pane to the totals
+static void add_to_totals(void *key, void *value, void *arg){
+    hashmap *totals = (hashmap *) arg;
+    int amount = *(int *) value;
+    int total = 0;
+    hashmap_get(totals, key, &total);
+    total += amount;
+    hashmap_put(totals, key, &total);
+}
+
+// helper for window_add_pane, subtracts the count of one word of an expired pane (a word that's gone is removed)
+static void subtract_from_totals(void *key, void *value, void *arg){
+    hashmap *totals = (hashmap *) arg;
+    int amount = *(int *) value;
+    int total = 0;
+    hashmap_get(totals, key, &total);
+    total -= amount;
+    if(total <= 0)
+        hashmap_remove(totals, key);
+    else
+        hashmap_put(totals, key, &total);
+}
+
+void window_add_pane(word_window *window, hashmap *pane){
+    assert(window);
+    assert(pane);
+
+    hashmap_for_each(pane, add_to_totals, window->totals);
+    list_insert_back(window->panes, &pane);
+    window->amount_of_panes++;
+
+    if(window->amount_of_panes > window->panes_per_window){
+        hashmap *expired = NULL;
+        list_remove_front(window->panes, &expired);
+        window->amount_of_panes--;
+        hashmap_for_each(expired, subtract_from_totals, window->totals);
+        hashmap_destroy(expired);
+    }
+    window->windows++;
+}
+
+// the current top N while the totals are visited
+typedef struct{
+    window_entry *entries;
+    size_t amount;
+    size_t capacity;
+    size_t words;
+}top_list;
+
+// same order as the final output of the batch mode: most frequent first, ties alphabetically
+static bool ranks_higher(const char *word1, int amount1, const char *word2, int amount2){
+    if(amount1 != amount2)
+        return amount1 > amount2;
+    return strcmp(word1, word2) < 0;
+}
+
+// helper for window_top_changes, inserts a word into the top N if it belongs there
+static void rank_word(void *key, void *value, void *arg){
+    top_list *top = (top_list *) arg;
+    const char *word = (const char *) key;
+    int amount = *(int *) value;
+    top->words++;
+
+    if(top->amount == top->capacity && !ranks_higher(word, amount, top->entries[top->amount-1].word, top->entries[top->amount-1].amount))
+        return;
+
+    size_t position = top->amount < top->capacity ? top->amount++ : top->amount - 1;
+    while(position > 0 && ranks_higher(word, amount, top->entries[position-1].word, top->entries[position-1].amount)){
+        top->entries[position] = top->entries[position-1];
+        position--;
+    }
+    strcpy(top->entries[position].word, word);
+    top->entries[position].amount = amount;
+}
+
+// appends a change to the message, which grows as needed (amount < 0 -> the word dropped out)
+static void append_change(char **message, size_t *len, size_t *capacity, const char *word, int amount){
+    size_t needed = strlen(word) + 16;
+    if(*len + needed > *capacity){
+        *capacity = (*len + needed) * 2;
+        *message = (char *) realloc(*message, *capacity);
+        if(!*message){
+            fprintf(stderr, "Could not allocate window message.\n");
+            exit(1);
+        }
+    }
+    if(amount < 0)
+        *len += (size_t) sprintf(&(*message)[*len], "-%s\n", word);
+    else
+        *len += (size_t) sprintf(&(*message)[*len], "%s,%d\n", word, amount);
+}
+
+char* window_top_changes(word_window *window){
+    assert(window);
+
+    top_list top = {0};
+    top.capacity = window->top_capacity;
+    top.entries = (window_entry *) calloc(top.capacity, sizeof(window_entry));
+    if(!top.entries){
+        fprintf(stderr, "Could not allocate window.\n");
+        exit(1);
+    }
+    hashmap_for_each(window->totals, rank_word, &top);
+
+    size_t len = 0;
+    size_t capacity = 256;
+    char *message = (char *) malloc(capacity);
+    if(!message){
+        fprintf(stderr, "Could not allocate window message.\n");
+        exit(1);
+    }
+    len = (size_t) sprintf(message, "window %llu %zu\n", window->windows, top.words);
+
+    // new or changed words
+    for(size_t i=0; i<top.amount; i++){
+        bool unchanged = false;
+        for(size_t j=0; j<window->amount_of_top; j++){
+            if(!strcmp(window->top[j].word, top.entries[i].word)){
+                unchanged = window->top[j].amount == top.entries[i].amount;
+                break;
+            }
+        }
+        if(!unchanged)
+            append_change(&message, &len, &capacity, top.entries[i].word, top.entries[i].amount);
+    }
+
+    // words that dropped out
+    for(size_t j=0; j<window->amount_of_top; j++){
+        bool still_there = false;
+        for(size_t i=0; i<top.amount && !still_there; i++)
+            still_there = !strcmp(window->top[j].word, top.entries[i].word);
+        if(!still_there)
+            append_change(&message, &len, &capacity, window->top[j].word, -1);
+    }
+
+    free(window->top);
+    window->top = top.entries;
+    window->amount_of_top = top.amount;
+    return message;
+}
+
+void window_destroy(word_window *window){
+    assert(window);
+    while(!list_is_empty(window->panes)){
+        hashmap *pane = NULL;
+        list_remove_front(window->panes, &pane);
+        hashmap_destroy(pane);
+    }
+    list_destroy(window->panes);
+    hashmap_destroy(window->totals);
+    free(window->top);
+    free(window);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+// This header houses the windowed word counts of the continuous mode
+// the stream is cut into panes (one per slide), a window consists of the last panes_per_window panes
+// the counts of the window are kept up to date incrementally: the newest pane is added, the one that falls out is subtracted
+// panes_per_window = 1 -> tumbling windows, otherwise sliding ones
+#include <stddef.h>
+#include "../lib/encoder.h"
+#include "../lib/hashmap.h"
+#include "../lib/linked_list.h"
+
+typedef struct{
+    char word[MSG_LEN];
+    int amount;
+}window_entry;
+
+typedef struct{
+    hashmap *totals;                // word -> count within the window
+    list_head *panes;               // hashmap* of the panes within the window, oldest first
+    size_t amount_of_panes;
+    size_t panes_per_window;
+    window_entry *top;              // top N of the last published window, most frequent first
+    size_t amount_of_top;
+    size_t top_capacity;            // N
+    unsigned long long windows;     // amount of windows so far
+}word_window;
+
+word_window* window_init(size_t panes_per_window, size_t top);
+// adds the counts of a pane (word -> int, keys of MSG_LEN bytes), the window takes ownership of the hashmap
+void window_add_pane(word_window *window, hashmap *pane);
+// returns the changes of the top N since the last call (malloc'd, NUL terminated, the caller frees it):
+//   "window <nr> <words in the window>\n", then "word,count\n" for every word that is new in the top N or whose count changed
+//   and "-word\n" for every word that isn't in the top N anymore
+char* window_top_changes(word_window *window);
+void window_destroy(word_window *window);
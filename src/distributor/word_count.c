@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include "../lib/linked_list.h"
+#include "./word_count.h"
+#include "./reduce_tree.h"
+
+// copy pasted this from the std c lib (would be easy to implement tho)
+static inline bool is_alpha(char c){
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+typedef struct{
+    char word[MSG_LEN];     //? this isn't memory efficient, but it can't fail any test, where a word is stupidly long
+    int amount;
+}key_value_pair;
+
+// compare function for list_merge_sort function
+static bool compare_pairs(void *data1, void *data2){
+    key_value_pair one = *(key_value_pair *) data1;
+    key_value_pair two = *(key_value_pair *) data2;
+    if(one.amount < two.amount)
+        return true;
+    if(one.amount > two.amount)
+        return false;
+
+    if(one.amount == two.amount){
+        int temp = strcmp(one.word, two.word);
+        if(temp>0)
+            return true;
+        if(temp<0)
+            return false;
+
+        // this should never trigger
+        fprintf(stderr, "Two words within the linked list match after combining every key,value pair");
+        exit(1);
+    }
+
+    // just because of ICO C standards (-Wreturn-type)
+    // in reality, this will never be reached
+    return false;
+}
+
+hashmap* word_counts_init(void){
+    return hashmap_init(50, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+}
+
+void save_map_result(const char *result, size_t len, void *arg){
+    FILE *map_temp_file = (FILE *) arg;
+    fwrite(result, 1, len, map_temp_file);
+}
+
+// adds amount to the count of the word
+static void add_count(hashmap *map, const char *word, int amount){
+    int word_count = amount;
+    if(hashmap_contains(map, word)){
+        hashmap_get(map, word, &word_count);
+        word_count += amount;
+    }
+    hashmap_put(map, word, &word_count);
+}
+
+void add_reduce_result_to_hashmap(const char *result, size_t len, void *arg){
+    hashmap *map = (hashmap *) arg;
+
+    key_value_pair pair;
+    pair.amount = 0;
+    pair.word[0] = '\0';
+    int word_end = 0;
+    int value_end = 0;
+    char value_as_string[10] = {0};  // 10 digits should be enough (if not, the one who made the testbench is smoking some good stuff)
+    for(size_t j=0; j<len && result[j] != '\0'; j++){
+        if(is_alpha(result[j])){
+            if(value_end > 0){
+                // new word begins -> add last word and number to hashmap
+                value_as_string[value_end] = '\0';
+                value_end = 0;
+
+                pair.amount = atoi(value_as_string);
+                add_count(map, pair.word, pair.amount);
+            }
+
+            pair.word[word_end] = result[j];
+            word_end++;
+        }
+        else{   // is a number
+            if(word_end > 0){
+                pair.word[word_end] = '\0';
+                word_end = 0;
+            }
+            value_as_string[value_end] = result[j];
+            value_end++;
+        }
+    }
+
+    // add last pair
+    value_as_string[value_end] = '\0';
+    value_end = 0;
+
+    pair.amount = atoi(value_as_string);
+    add_count(map, pair.word, pair.amount);
+}
+
+void id_counts_init(id_counts *ids, hashmap *counts, word_dictionary *dictionary){
+    assert(ids);
+    assert(counts);
+    assert(dictionary);
+    memset(ids, 0, sizeof(id_counts));
+    ids->counts = counts;
+    ids->dictionary = dictionary;
+}
+
+void add_id_result_to_counts(const char *result, size_t len, void *arg){
+    id_counts *ids = (id_counts *) arg;
+
+    // the dictionary may have grown since the last reply (MAP phases of other jobs)
+    if(ids->capacity < ids->dictionary->amount){
+        size_t capacity = ids->dictionary->amount;
+        ids->by_id = (int *) realloc(ids->by_id, capacity * sizeof(int));
+        if(!ids->by_id){
+            fprintf(stderr, "Could not allocate counts of the word IDs.\n");
+            exit(1);
+        }
+        memset(&ids->by_id[ids->capacity], 0, (capacity - ids->capacity) * sizeof(int));
+        ids->capacity = capacity;
+    }
+
+    size_t pos = 0;
+    const char *key;
+    size_t key_len;
+    uint32_t count;
+    while(word_ids_next_entry(result, len, &pos, &key, &key_len, &count)){
+        if(!is_id_byte(key[0])){
+            char word[MSG_LEN];
+            memcpy(word, key, key_len);
+            word[key_len] = '\0';
+            add_count(ids->counts, word, (int) count);
+            continue;
+        }
+
+        size_t id_len = 0;
+        uint32_t id = 0;
+        if(!varint_get(key, key_len, &id_len, WORD_ID_BYTE, &id) || id_len != key_len || id >= ids->capacity){
+            fprintf(stderr, "Invalid word ID in RED result.\n");
+            exit(1);
+        }
+        ids->by_id[id] += (int) count;
+    }
+    if(pos < len && result[pos] != '\0'){
+        fprintf(stderr, "Invalid entry in RED result.\n");
+        exit(1);
+    }
+}
+
+void id_counts_flush(id_counts *ids){
+    assert(ids);
+    for(size_t id=0; id<ids->capacity; id++){
+        if(ids->by_id[id] <= 0)
+            continue;
+        char word[MSG_LEN] = {0};     // the hashmap copies MSG_LEN bytes of the key
+        strcpy(word, word_dictionary_word(ids->dictionary, (uint32_t) id));
+        add_count(ids->counts, word, ids->by_id[id]);
+    }
+    free(ids->by_id);
+    ids->by_id = NULL;
+    ids->capacity = 0;
+}
+
+MSG_TYPE map_command(scheduler *sched, const count_options *options){
+    assert(sched);
+    assert(options);
+    if(sched->dictionary)
+        return MAP_IDS;
+    return options->combine ? MAP_COMBINED : MAP;
+}
+
+int count_words(scheduler *sched, chunker *input, hashmap *counts, const count_options *options){
+    assert(sched);
+    assert(input);
+    assert(counts);
+    assert(options);
+
+    // temp file for result of map
+    FILE *map_results = tmpfile();
+    if(!map_results){
+        fprintf(stderr, "Failed to create temporary file for MAP results with write privileges.\n");
+        exit(1);
+    }
+    if(scheduler_run_phase(sched, input, map_command(sched, options), save_map_result, map_results) != 0){
+        fclose(map_results);
+        return 1;
+    }
+
+    // one phase per level of the reduce tree (just one without a tree)
+    int failed = 0;
+    reduce_tree tree;
+    bool reducing = reduce_tree_init(&tree, sched, map_results, counts, options);
+    while(reducing){
+        scheduler_phase phase;
+        reduce_tree_phase_init(&tree, &phase, 1);
+        scheduler_phase *phases[1] = {&phase};
+        while(!scheduler_phase_is_done(&phase))
+            scheduler_step(sched, phases, 1, NULL);
+        scheduler_phase_destroy(&phase);
+        if(phase.failed){
+            failed = 1;
+            break;
+        }
+        reducing = reduce_tree_next_level(&tree);
+    }
+    reduce_tree_destroy(&tree);
+    fclose(map_results);
+    return failed;
+}
+
+// helper for write_word_counts
+static void add_pair_to_list(void *key, void *value, void *arg){
+    key_value_pair pair;
+    strcpy(pair.word, (char *) key);
+    pair.amount = *(int *) value;
+    list_insert_back((list_head *) arg, &pair);
+}
+
+void write_word_counts(hashmap *counts, FILE *out){
+    assert(counts);
+    assert(out);
+
+    list_head *result = list_init(sizeof(key_value_pair));
+    hashmap_for_each(counts, add_pair_to_list, result);
+    list_merge_sort(result, compare_pairs);
+
+    fprintf(out, "word,frequency\n");
+    while(!list_is_empty(result)){
+        key_value_pair pair;
+        list_remove_back(result, &pair);
+        if(pair.word[0] == '\0')
+            continue;
+        fprintf(out, "%s,%d\n", pair.word, pair.amount);
+    }
+    list_destroy(result);
+}
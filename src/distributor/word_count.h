@@ -0,0 +1,49 @@
+#pragma once
+
+// This header houses the counting of one input: MAP and RED on the workers and the aggregation of their results
+// it is shared by the batch mode, the continuous mode and the job server
+#include <stdio.h>
+#include <stdbool.h>
+#include "../lib/encoder.h"
+#include "../lib/hashmap.h"
+#include "../lib/word_ids.h"
+#include "./chunker.h"
+#include "./scheduler.h"
+
+// how the MAP results of a count are reduced (options of the distributor)
+typedef struct{
+    bool combine;       // MAP sends every word of a chunk once with its count (MAP_COMBINED), RED merges those (COMBINE)
+    size_t fan_in;      // RED runs as a tree until at most this many tables are left (0 -> no tree, see reduce_tree.h)
+}count_options;
+
+// hashmap of word (char[MSG_LEN]) -> count (int), the way the RED results are aggregated
+hashmap* word_counts_init(void);
+// MAP result handler: appends the map output to the FILE* given as arg
+void save_map_result(const char *result, size_t len, void *arg);
+// RED result handler: adds the word counts of one reply to the hashmap given as arg
+void add_reduce_result_to_hashmap(const char *result, size_t len, void *arg);
+
+// RED results with word IDs (see word_ids.h) are added up by ID first, that's an array instead of a hashmap,
+// only the words without ID and (once the phase is done) the sums of the IDs end up in the hashmap
+typedef struct{
+    hashmap *counts;
+    word_dictionary *dictionary;
+    int *by_id;
+    size_t capacity;
+}id_counts;
+
+void id_counts_init(id_counts *ids, hashmap *counts, word_dictionary *dictionary);
+// RED_IDS result handler: adds the entries of one reply to the id_counts given as arg
+void add_id_result_to_counts(const char *result, size_t len, void *arg);
+// adds the sums of the IDs to the hashmap and frees them
+void id_counts_flush(id_counts *ids);
+// command of the MAP tasks: MAP_IDS if the scheduler has a dictionary (its results are combined already), else
+// MAP_COMBINED or MAP
+MSG_TYPE map_command(scheduler *sched, const count_options *options);
+// runs MAP over the input (its results go into a temporary file) and RED over the results, the counts are added to counts
+// with word IDs if the scheduler has a dictionary
+// the input is done afterwards (or its deadline is over, see chunker_set_deadline)
+// returns 0 on success, 1 if a task failed too often (the counts are incomplete then)
+int count_words(scheduler *sched, chunker *input, hashmap *counts, const count_options *options);
+// writes "word,frequency" and a line per word, most frequent first (ties alphabetically), the counts stay as they are
+void write_word_counts(hashmap *counts, FILE *out);
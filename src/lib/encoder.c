@@ -7,8 +7,14 @@
  * map - map auf payload ausführen
  * red - reduce auf payload ausführen
  * rip - worker herunterfahren
+ * hey - worker meldet sich beim distributor an
+ * bye - worker meldet sich beim distributor ab
+ * mpi - map mit wort ids (siehe word_ids.h)
+ * rdi - reduce mit wort ids
+ * cmb - ergebnisse von reduce zusammenfassen
+ * mpc - map mit zusammengefassten zaehlern (wie reduce)
  */
-char types[3][4] = {"map", "red", "rip"};
+char types[9][4] = {"map", "red", "rip", "hey", "bye", "mpi", "rdi", "cmb", "mpc"};
 
 // yes, this whole encode from and to worker thing is ugly, but I have no other choice, since the worker might receive
 // words like ripeness at the start of a string, and shall not interpret it as a "kill" command
@@ -31,7 +37,7 @@ int encode_msg(char msg_buff[], char payload[], MSG_TYPE type){
     assert(msg_buff);
     assert(payload);
     
-    if(type==MAP || type==RED || type==INVALID)
+    if(type==MAP || type==RED || type==MAP_IDS || type==RED_IDS || type==COMBINE || type==MAP_COMBINED || type==INVALID)
         return 1;
     
     if(type == RIP){
@@ -39,6 +45,12 @@ int encode_msg(char msg_buff[], char payload[], MSG_TYPE type){
         return 0;
     }
 
+    if(type == HEY || type == BYE){
+        strcpy(msg_buff, (char *)&types[type]);
+        strcpy(&msg_buff[3], payload);
+        return 0;
+    }
+
     // type == empty
     strcpy(msg_buff, payload);
     return 0;
@@ -88,4 +100,64 @@ MSG_TYPE decode_msg_from_worker(char msg_buff[], char payload[]){
     // -> no checking for INVALID types here
     strcpy(payload, msg_buff);
     return EMPTY;
-}
\ No newline at end of file
+}
+
+// length of the string within the first len bytes
+static size_t bounded_len(const char *string, size_t len){
+    const char *end = memchr(string, '\0', len);
+    return end ? (size_t)(end - string) : len;
+}
+
+msg_view decode_msg_view(const char *msg_buff, size_t len){
+    assert(msg_buff || len == 0);
+
+    msg_view view = {INVALID, "", 0};
+    len = len ? bounded_len(msg_buff, len) : 0;
+    if(len < 3)
+        return view;
+
+    for(MSG_TYPE type=MAP; type<EMPTY; type++){
+        if(!strncmp(msg_buff, (char *)&types[type], 3)){
+            view.type = type;
+            view.payload = &msg_buff[3];
+            view.len = len - 3;
+            return view;
+        }
+    }
+    return view;
+}
+
+msg_view decode_msg_view_from_worker(const char *msg_buff, size_t len){
+    assert(msg_buff || len == 0);
+
+    msg_view view = {EMPTY, "", 0};
+    len = len ? bounded_len(msg_buff, len) : 0;
+    if(len == 0)
+        return view;
+
+    // see decode_msg_from_worker, only a bare "rip" is a RIP
+    if(len == 3 && !strncmp(msg_buff, (char *)&types[2], 3)){
+        view.type = RIP;
+        return view;
+    }
+
+    view.payload = msg_buff;
+    view.len = len;
+    return view;
+}
+
+int encode_msg_to_worker_zmq(zmq_msg_t *msg, const char *payload, size_t len, MSG_TYPE type){
+    assert(msg);
+    assert(payload || len == 0);
+
+    if(type==INVALID || type==EMPTY)
+        return 1;
+    if(zmq_msg_init_size(msg, 3 + len + 1) != 0)
+        return 1;
+
+    char *data = (char *) zmq_msg_data(msg);
+    memcpy(data, (char *)&types[type], 3);
+    memcpy(&data[3], payload, len);
+    data[3 + len] = '\0';
+    return 0;
+}
@@ -2,12 +2,23 @@
 
 //! WARNING: Both functions assume that the supplied buffer size is sufficient
 // These functions handle the encoding and decoding of zmq messages.
+#include <stddef.h>
+#include <zmq.h>
+
+// maximum size of one zmq message (3 chars command + payload + NUL)
+#define MSG_LEN 1500
 
 // this is being used to describe the type of function that should be or has been encoded
 typedef enum{
     MAP,
     RED,
     RIP,
+    HEY,        // worker registers at a distributor that listens (payload: "<threads> <host> <credits>", credits default to threads)
+    BYE,        // registered worker wants to leave, it gets a RIP once its tasks are done
+    MAP_IDS,    // MAP with word IDs (payload: dictionary update + text, see word_ids.h)
+    RED_IDS,    // RED of MAP results with word IDs
+    COMBINE,    // merges RED results ("word3another2") into one table (reduce tree, see reduce_tree.h)
+    MAP_COMBINED,   // MAP that sends every word once with its count ("word3another2", like RED), its RED is a COMBINE
     EMPTY,      // for response of worker thread
     INVALID     // for error handling
 }MSG_TYPE;
@@ -27,4 +38,19 @@ MSG_TYPE decode_msg(char msg_buff[], char payload[]);
 // jokes aside, I dislike this very much and I'd rather send a NUL or something as a 'command',
 // because that would be a much cleaner way to do so (consistent spacing of packages),
 // but then, I wouldn't pass the tests, so here we are...
-MSG_TYPE decode_msg_from_worker(char msg_buff[], char payload[]);
\ No newline at end of file
+MSG_TYPE decode_msg_from_worker(char msg_buff[], char payload[]);
+
+// view into a message, nothing is copied
+typedef struct{
+    MSG_TYPE type;
+    const char *payload;        // points into the message (or to "" if there is none), not necessarily NUL terminated
+    size_t len;                 // length of the payload without the NUL
+}msg_view;
+
+// same as the decode functions above, but they work on the received bytes (e.g. zmq_msg_data()) instead of copying the payload
+// len is the size of the message, it doesn't have to be NUL terminated
+msg_view decode_msg_view(const char *msg_buff, size_t len);
+msg_view decode_msg_view_from_worker(const char *msg_buff, size_t len);
+// initializes msg with the command and the payload (len bytes, doesn't have to be NUL terminated) + NUL
+// this is the only copy of the payload, zmq_msg_send takes the message as is (returns 0 on success)
+int encode_msg_to_worker_zmq(zmq_msg_t *msg, const char *payload, size_t len, MSG_TYPE type);
@@ -216,6 +216,20 @@ void hashmap_print(hashmap *map, void (*print_function)(void *data)){
 }
 
 
+void hashmap_for_each(hashmap *map, void (*handle_each_element)(void *key, void *value, void *arg), void *arg){
+    assert(map);
+    assert(handle_each_element);
+
+    for(size_t i=0; i<map->list_amount; i++){
+        struct list_node *curr = map->lists[i]->first;
+        while(curr){
+            hashmap_entry *entry = (hashmap_entry *) curr->data;
+            handle_each_element(entry->key, entry->value, arg);
+            curr = curr->next;
+        }
+    }
+}
+
 void hashmap_to_string(hashmap *map, char *buffer, void (*to_string_function)(char *buffer, void *key, void *value)){
     assert(map);
     assert(buffer);
@@ -31,6 +31,8 @@ void hashmap_put(hashmap *map, const void *key, const void *value);
 bool hashmap_get(hashmap *map, const void *key, void *value);
 void hashmap_remove(hashmap *map, const void *key);
 void hashmap_print(hashmap *map, void (*print_function)(void *data));
+// calls handle_each_element for every element, the value may be changed, but the hashmap itself mustn't be changed within it
+void hashmap_for_each(hashmap *map, void (*handle_each_element)(void *key, void *value, void *arg), void *arg);
 // expects a buffer of sufficient size for storing the result, writing itself is happening in the to_string_function
 void hashmap_to_string(hashmap *map, char *buffer, void (*to_string_function)(char *buffer, void *key, void *value));
 // it empties the hashmap, but it doesn't free it
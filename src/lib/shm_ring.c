@@ -0,0 +1,149 @@
+#include "./shm_ring.h"
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// every message starts with its id (8 bytes) and its length (4 bytes)
+#define HEADER_LEN 12
+
+static shm_channel* map_channel(const char *name, int flags){
+    int fd = shm_open(name, flags, 0600);
+    if(fd < 0)
+        return NULL;
+
+    if((flags & O_CREAT) && ftruncate(fd, sizeof(shm_channel)) != 0){
+        close(fd);
+        return NULL;
+    }
+
+    void *memory = mmap(NULL, sizeof(shm_channel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);      // the mapping keeps the memory alive
+    if(memory == MAP_FAILED)
+        return NULL;
+    return (shm_channel *) memory;
+}
+
+shm_channel* shm_channel_create(const char *name){
+    assert(name);
+    shm_unlink(name);       // fresh memory is zeroed, so both rings start out empty
+    return map_channel(name, O_RDWR | O_CREAT | O_EXCL);
+}
+
+shm_channel* shm_channel_open(const char *name){
+    assert(name);
+    return map_channel(name, O_RDWR);
+}
+
+void shm_channel_close(shm_channel *channel){
+    assert(channel);
+    munmap(channel, sizeof(shm_channel));
+}
+
+void shm_channel_unlink(const char *name){
+    assert(name);
+    shm_unlink(name);
+}
+
+// the notification sockets live in a directory only the user can access, /tmp itself is writable by everyone, so
+// anybody could bind the socket of a name first (and get the tasks) or connect to it
+// a directory that belongs to somebody else or that others can access is refused
+static int private_directory(char dir[], size_t len){
+    int written = snprintf(dir, len, "/tmp/wordcount-%u", (unsigned int) getuid());
+    if(written < 0 || (size_t) written >= len)
+        return 1;
+    if(mkdir(dir, 0700) != 0 && errno != EEXIST){
+        fprintf(stderr, "Could not create %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+
+    struct stat info;
+    if(lstat(dir, &info) != 0 || !S_ISDIR(info.st_mode) || info.st_uid != getuid() || (info.st_mode & 077)){
+        fprintf(stderr, "%s has to be a directory that only belongs to the user.\n", dir);
+        return 1;
+    }
+    return 0;
+}
+
+int shm_notify_endpoint(const char *name, char endpoint[], size_t len){
+    assert(name);
+    assert(endpoint);
+    while(*name == '/')
+        name++;
+
+    char dir[64];
+    if(private_directory(dir, sizeof(dir)) != 0)
+        return 1;
+    int written = snprintf(endpoint, len, "ipc://%s/%s.shm.zmq", dir, name);
+    return (written < 0 || (size_t) written >= len);
+}
+
+// copies into the ring at the given (total) position, the copy may wrap around the end
+static void copy_in(shm_ring *ring, uint64_t pos, const void *src, size_t len){
+    size_t offset = pos & (SHM_RING_SIZE - 1);
+    size_t first = SHM_RING_SIZE - offset < len ? SHM_RING_SIZE - offset : len;
+    memcpy(&ring->data[offset], src, first);
+    memcpy(ring->data, (const char *) src + first, len - first);
+}
+
+static void copy_out(shm_ring *ring, uint64_t pos, void *dest, size_t len){
+    size_t offset = pos & (SHM_RING_SIZE - 1);
+    size_t first = SHM_RING_SIZE - offset < len ? SHM_RING_SIZE - offset : len;
+    memcpy(dest, &ring->data[offset], first);
+    memcpy((char *) dest + first, ring->data, len - first);
+}
+
+int shm_ring_write(shm_ring *ring, uint64_t id, const char *data, uint32_t len){
+    assert(data || len == 0);
+    struct iovec part = {(void *) data, len};
+    return shm_ring_write_parts(ring, id, &part, 1);
+}
+
+int shm_ring_write_parts(shm_ring *ring, uint64_t id, const struct iovec parts[], size_t amount_of_parts){
+    assert(ring);
+    assert(parts || amount_of_parts == 0);
+
+    uint32_t len = 0;
+    for(size_t i=0; i<amount_of_parts; i++)
+        len += (uint32_t) parts[i].iov_len;
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(SHM_RING_SIZE - (head - tail) < HEADER_LEN + (uint64_t) len)
+        return 1;
+
+    copy_in(ring, head, &id, sizeof(id));
+    copy_in(ring, head + sizeof(id), &len, sizeof(len));
+    uint64_t pos = head + HEADER_LEN;
+    for(size_t i=0; i<amount_of_parts; i++){
+        copy_in(ring, pos, parts[i].iov_base, parts[i].iov_len);
+        pos += parts[i].iov_len;
+    }
+
+    // the reader must not see the new head before the message itself
+    atomic_store_explicit(&ring->head, head + HEADER_LEN + len, memory_order_release);
+    return 0;
+}
+
+long shm_ring_read(shm_ring *ring, uint64_t *id, char buffer[], size_t buffer_len){
+    assert(ring);
+    assert(id);
+    assert(buffer);
+
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(head == tail)
+        return -1;
+
+    uint32_t len = 0;
+    copy_out(ring, tail, id, sizeof(*id));
+    copy_out(ring, tail + sizeof(*id), &len, sizeof(len));
+    copy_out(ring, tail + HEADER_LEN, buffer, len < buffer_len ? len : buffer_len);
+
+    atomic_store_explicit(&ring->tail, tail + HEADER_LEN + len, memory_order_release);
+    return len;
+}
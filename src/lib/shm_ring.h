@@ -0,0 +1,45 @@
+#pragma once
+
+// This header houses a single producer/ single consumer ring buffer in POSIX shared memory (shm_open + mmap)
+// it carries whole messages ([id][length][bytes]) between two processes on the same machine without any syscall,
+// a channel consists of two rings, one per direction
+// there is no blocking in here, the writer has to tell the reader that there is something to read (e.g. with a zmq message)
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
+
+// bytes per ring, has to be a power of 2 (way more than a handful of 1500 byte messages)
+#define SHM_RING_SIZE (1 << 16)
+
+typedef struct{
+    _Atomic uint64_t head;      // bytes written in total (only the writer changes this)
+    _Atomic uint64_t tail;      // bytes read in total (only the reader changes this)
+    char data[SHM_RING_SIZE];
+}shm_ring;
+
+typedef struct{
+    shm_ring requests;          // distributor -> worker
+    shm_ring replies;           // worker -> distributor
+}shm_channel;
+
+// creates the shared memory object with the given name (e.g. "/wc0"), an old one with the same name is replaced
+// returns NULL on error
+shm_channel* shm_channel_create(const char *name);
+// opens an existing shared memory object, returns NULL if it doesn't exist (yet)
+shm_channel* shm_channel_open(const char *name);
+void shm_channel_close(shm_channel *channel);
+// removes the name, the memory stays valid until every process closed it
+void shm_channel_unlink(const char *name);
+// writes the zmq endpoint both sides use for the notifications of the channel into the buffer, returns 0 on success
+// the endpoint is an ipc socket in /tmp/wordcount-<uid> (created with mode 0700 if it doesn't exist yet), it fails if that
+// directory belongs to another user or others can access it
+int shm_notify_endpoint(const char *name, char endpoint[], size_t len);
+
+// returns 0 on success or 1 if there isn't enough room in the ring
+int shm_ring_write(shm_ring *ring, uint64_t id, const char *data, uint32_t len);
+// writes the parts as one message, each of them is copied right into the ring (e.g. a command in front of a chunk)
+int shm_ring_write_parts(shm_ring *ring, uint64_t id, const struct iovec parts[], size_t amount_of_parts);
+// copies the oldest message into the buffer (it's truncated to buffer_len bytes) and sets *id to its id
+// returns the length of the message or -1 if the ring is empty
+long shm_ring_read(shm_ring *ring, uint64_t *id, char buffer[], size_t buffer_len);
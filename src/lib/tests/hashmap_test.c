@@ -13,6 +13,11 @@ inline size_t string_hash(const void *key) {
     return hash;
 }
 
+// sums up the values and increases each one by 1 for the next call
+void add_value(void *key, void *value, void *arg) {
+    (void) key;
+    *(int *) arg += (*(int *) value)++;
+}
 
 void test_hashmap() {
     printf("🚀 Starting hashmap tests...\n");
@@ -68,6 +73,13 @@ void test_hashmap() {
         assert(hashmap_get(map, key, &result) && result == i);
     }
 
+    // visit every element, the values can be changed on the way
+    int sum = 0;
+    hashmap_for_each(map, add_value, &sum);
+    assert(sum == 42 + 123 + 190);
+    hashmap_for_each(map, add_value, &sum);
+    assert(sum == 2 * (42 + 123 + 190) + 22);
+
     hashmap_destroy(map);
 
     printf("\033[32mOK\033[0m All tests passed!\n");
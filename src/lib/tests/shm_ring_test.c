@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include "../shm_ring.h"
+
+void test_shm_ring(){
+    printf("🚀 Starting shared memory ring tests...\n");
+
+    shm_channel *writer = shm_channel_create("/shm_ring_test");
+    assert(writer != NULL);
+    shm_channel *reader = shm_channel_open("/shm_ring_test");
+    assert(reader != NULL);
+
+    char buffer[64];
+    uint64_t id = 0;
+    assert(shm_ring_read(&reader->requests, &id, buffer, sizeof(buffer)) == -1);
+
+    // messages arrive in order with their ids
+    assert(shm_ring_write(&writer->requests, 1, "hello", 6) == 0);
+    assert(shm_ring_write(&writer->requests, 2, "world", 6) == 0);
+    assert(shm_ring_read(&reader->requests, &id, buffer, sizeof(buffer)) == 6);
+    assert(id == 1 && !strcmp(buffer, "hello"));
+    assert(shm_ring_read(&reader->requests, &id, buffer, sizeof(buffer)) == 6);
+    assert(id == 2 && !strcmp(buffer, "world"));
+    assert(shm_ring_read(&reader->requests, &id, buffer, sizeof(buffer)) == -1);
+
+    // the other direction is independent
+    assert(shm_ring_read(&writer->replies, &id, buffer, sizeof(buffer)) == -1);
+
+    // fill the ring until it's full and drain it again (wraps around the end several times)
+    char message[1000];
+    memset(message, 'a', sizeof(message));
+    for(int round=0; round<5; round++){
+        uint64_t written = 0;
+        while(shm_ring_write(&writer->replies, written, message, sizeof(message)) == 0)
+            written++;
+        assert(written == SHM_RING_SIZE / (sizeof(message) + 12));
+
+        char big[sizeof(message)];
+        for(uint64_t i=0; i<written; i++){
+            assert(shm_ring_read(&reader->replies, &id, big, sizeof(big)) == sizeof(message));
+            assert(id == i && !memcmp(big, message, sizeof(message)));
+        }
+        assert(shm_ring_read(&reader->replies, &id, big, sizeof(big)) == -1);
+        assert(shm_ring_write(&writer->replies, 0, message, 7) == 0);       // shifts the next round
+        assert(shm_ring_read(&reader->replies, &id, big, sizeof(big)) == 7);
+    }
+
+    // a message written in parts arrives in one piece, also if it wraps around the end
+    for(int round=0; round<100; round++){
+        struct iovec parts[3] = {{"map", 3}, {message, 333}, {"", 1}};
+        assert(shm_ring_write_parts(&writer->requests, 42, parts, 3) == 0);
+        char big[sizeof(message)];
+        assert(shm_ring_read(&reader->requests, &id, big, sizeof(big)) == 337);
+        assert(id == 42 && !memcmp(big, "map", 3) && !memcmp(&big[3], message, 333) && big[336] == '\0');
+    }
+
+    // the notification endpoint is in a directory only the user can access
+    char endpoint[256];
+    assert(shm_notify_endpoint("/shm_ring_test", endpoint, sizeof(endpoint)) == 0);
+    assert(!strncmp(endpoint, "ipc:///tmp/wordcount-", strlen("ipc:///tmp/wordcount-")));
+    struct stat info;
+    *strrchr(endpoint, '/') = '\0';
+    assert(stat(&endpoint[strlen("ipc://")], &info) == 0 && S_ISDIR(info.st_mode) && (info.st_mode & 077) == 0);
+
+    shm_channel_close(reader);
+    shm_channel_close(writer);
+    shm_channel_unlink("/shm_ring_test");
+    assert(shm_channel_open("/shm_ring_test") == NULL);
+
+    printf("✅ All shared memory ring tests passed!\n");
+}
+
+int main(){
+    test_shm_ring();
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "../word_ids.h"
+
+void test_word_ids(){
+    printf("🚀 Starting word ID tests...\n");
+
+    // varints never contain a NUL and the two kinds don't mix
+    char buffer[256];
+    uint32_t values[] = {0, 1, 31, 32, 1000, 32767, 4294967295u};
+    for(size_t i=0; i<sizeof(values)/sizeof(values[0]); i++){
+        size_t len = varint_put(buffer, values[i], WORD_COUNT_BYTE);
+        assert(len == varint_len(values[i]) && len <= VARINT_LEN);
+        for(size_t j=0; j<len; j++)
+            assert(is_count_byte(buffer[j]));
+
+        size_t pos = 0;
+        uint32_t value = 0;
+        assert(!varint_get(buffer, len, &pos, WORD_ID_BYTE, &value));
+        assert(varint_get(buffer, len, &pos, WORD_COUNT_BYTE, &value));
+        assert(pos == len && value == values[i]);
+    }
+
+    // "and" 7 times, ID 40 once
+    memcpy(buffer, "and", 3);
+    size_t len = 3;
+    len += varint_put(&buffer[len], 7, WORD_COUNT_BYTE);
+    len += varint_put(&buffer[len], 40, WORD_ID_BYTE);
+    len += varint_put(&buffer[len], 1, WORD_COUNT_BYTE);
+    buffer[len] = '\0';
+
+    size_t pos = 0;
+    const char *key;
+    size_t key_len;
+    uint32_t count;
+    assert(word_ids_next_entry(buffer, len, &pos, &key, &key_len, &count));
+    assert(key_len == 3 && !memcmp(key, "and", 3) && count == 7);
+    assert(word_ids_next_entry(buffer, len, &pos, &key, &key_len, &count));
+    assert(key_len == 2 && is_id_byte(key[0]) && count == 1);
+    assert(!word_ids_next_entry(buffer, len, &pos, &key, &key_len, &count));
+    assert(pos == len);
+
+    // a word without count is malformed
+    pos = 0;
+    assert(!word_ids_next_entry("and", 3, &pos, &key, &key_len, &count) && pos == 0);
+
+    // the distributor sends the words in parts, the worker takes them in order
+    word_dictionary *distributor = word_dictionary_init();
+    word_dictionary *worker = word_dictionary_init();
+    assert(word_dictionary_add(distributor, "the") == 0);
+    assert(word_dictionary_add(distributor, "and") == 1);
+    assert(word_dictionary_add(distributor, "because") == 2);
+    assert(word_dictionary_add(distributor, "something") == 3);
+    assert(word_dictionary_find(distributor, "and") == 1);
+    assert(word_dictionary_find(distributor, "or") == -1);
+    assert(!strcmp(word_dictionary_word(distributor, 2), "because"));
+    assert(word_dictionary_word(distributor, 4) == NULL);
+
+    size_t to = 0;
+    len = word_dictionary_write_update(distributor, 0, buffer, 2 * VARINT_LEN, &to);
+    assert(to == 2);
+    memcpy(&buffer[len], "text", 5);
+    assert(word_dictionary_apply_update(worker, buffer, len + 4) == (long) len);
+    assert(worker->amount == 2 && word_dictionary_find(worker, "and") == 1);
+
+    // the same update again changes nothing, an update behind a gap is skipped
+    assert(word_dictionary_apply_update(worker, buffer, len) == (long) len);
+    assert(worker->amount == 2);
+    len = word_dictionary_write_update(distributor, 3, buffer, sizeof(buffer), &to);
+    assert(to == 4);
+    assert(word_dictionary_apply_update(worker, buffer, len) == (long) len);
+    assert(worker->amount == 2);
+
+    len = word_dictionary_write_update(distributor, 1, buffer, sizeof(buffer), &to);
+    assert(to == 4);
+    assert(word_dictionary_apply_update(worker, buffer, len) == (long) len);
+    assert(worker->amount == 4 && word_dictionary_find(worker, "something") == 3);
+    assert(word_dictionary_apply_update(worker, "the", 3) == -1);
+
+    // frequent words of the MAP results get an ID, words that aren't longer than their ID don't
+    word_dictionary *observed = word_dictionary_init();
+    memcpy(buffer, "word", 4);
+    len = 4;
+    len += varint_put(&buffer[len], WORD_ID_MIN_COUNT - 1, WORD_COUNT_BYTE);
+    buffer[len++] = 'a';
+    len += varint_put(&buffer[len], 100, WORD_COUNT_BYTE);
+    word_dictionary_observe(observed, buffer, len);
+    assert(observed->amount == 0);
+    len = 4;
+    len += varint_put(&buffer[len], 1, WORD_COUNT_BYTE);
+    word_dictionary_observe(observed, buffer, len);
+    assert(observed->amount == 1 && word_dictionary_find(observed, "word") == 0);
+    assert(word_dictionary_find(observed, "a") == -1);
+
+    word_dictionary_destroy(observed);
+    word_dictionary_destroy(worker);
+    word_dictionary_destroy(distributor);
+
+    printf("✅ All word ID tests passed!\n");
+}
+
+int main(){
+    test_word_ids();
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "./word_ids.h"
+
+// buckets of the hashmaps (they don't grow), the candidates are every word that has been seen so far
+#define ID_BUCKETS (1 << 12)
+#define CANDIDATE_BUCKETS (1 << 14)
+
+static inline bool is_alpha(char c){
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+size_t varint_put(char *buffer, uint32_t value, unsigned char kind){
+    assert(buffer);
+    assert(kind == WORD_ID_BYTE || kind == WORD_COUNT_BYTE);
+
+    size_t len = 0;
+    do{
+        unsigned char byte = kind | (value & 0x1F);
+        value >>= 5;
+        if(value)
+            byte |= VARINT_MORE;
+        buffer[len++] = (char) byte;
+    }while(value);
+    return len;
+}
+
+size_t varint_len(uint32_t value){
+    size_t len = 1;
+    while(value >>= 5)
+        len++;
+    return len;
+}
+
+bool varint_get(const char *data, size_t len, size_t *pos, unsigned char kind, uint32_t *value){
+    assert(data || len == 0);
+    assert(pos);
+    assert(value);
+
+    uint32_t result = 0;
+    for(size_t i=*pos, shift=0; i<len && ((unsigned char) data[i] & 0xC0) == kind && shift<5*VARINT_LEN; i++, shift+=5){
+        unsigned char byte = (unsigned char) data[i];
+        result |= (uint32_t)(byte & 0x1F) << shift;
+        if(!(byte & VARINT_MORE)){
+            *pos = i + 1;
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool word_ids_next_entry(const char *data, size_t len, size_t *pos, const char **key, size_t *key_len, uint32_t *count){
+    assert(data || len == 0);
+    assert(pos);
+    assert(key);
+    assert(key_len);
+    assert(count);
+
+    size_t start = *pos;
+    size_t end = start;
+    if(end >= len || data[end] == '\0')
+        return false;
+
+    // either an ID or a word, never both
+    if(is_id_byte(data[end])){
+        while(end < len && is_id_byte(data[end]))
+            end++;
+    }
+    else{
+        while(end < len && is_alpha(data[end]))
+            end++;
+    }
+
+    size_t next = end;
+    if(end == start || !varint_get(data, len, &next, WORD_COUNT_BYTE, count))
+        return false;
+    *key = &data[start];
+    *key_len = end - start;
+    *pos = next;
+    return true;
+}
+
+word_dictionary* word_dictionary_init(void){
+    word_dictionary *dictionary = (word_dictionary *) calloc(1, sizeof(word_dictionary));
+    if(!dictionary){
+        fprintf(stderr, "Could not allocate word dictionary.\n");
+        exit(1);
+    }
+    dictionary->ids = hashmap_init(ID_BUCKETS, WORD_ID_WORD_LEN, sizeof(uint32_t), NULL, NULL);
+    return dictionary;
+}
+
+int64_t word_dictionary_find(word_dictionary *dictionary, const char *word){
+    assert(dictionary);
+    assert(word);
+
+    uint32_t id = 0;
+    if(strlen(word) >= WORD_ID_WORD_LEN || !hashmap_get(dictionary->ids, word, &id))
+        return -1;
+    return id;
+}
+
+const char* word_dictionary_word(word_dictionary *dictionary, uint32_t id){
+    assert(dictionary);
+    return id < dictionary->amount ? dictionary->words[id] : NULL;
+}
+
+uint32_t word_dictionary_add(word_dictionary *dictionary, const char *word){
+    assert(dictionary);
+    assert(word);
+    assert(strlen(word) < WORD_ID_WORD_LEN);
+
+    if(dictionary->amount >= MAX_WORD_IDS){
+        fprintf(stderr, "The word dictionary is full.\n");
+        exit(1);
+    }
+    if(dictionary->amount == dictionary->capacity){
+        dictionary->capacity = dictionary->capacity ? dictionary->capacity * 2 : 1024;
+        dictionary->words = (char (*)[WORD_ID_WORD_LEN]) realloc(dictionary->words, dictionary->capacity * WORD_ID_WORD_LEN);
+        if(!dictionary->words){
+            fprintf(stderr, "Could not allocate word dictionary.\n");
+            exit(1);
+        }
+    }
+
+    // the hashmap copies WORD_ID_WORD_LEN bytes of the key, so it's padded with NULs
+    uint32_t id = (uint32_t) dictionary->amount++;
+    memset(dictionary->words[id], 0, WORD_ID_WORD_LEN);
+    strcpy(dictionary->words[id], word);
+    hashmap_put(dictionary->ids, dictionary->words[id], &id);
+    return id;
+}
+
+size_t word_dictionary_write_update(word_dictionary *dictionary, size_t from, char *buffer, size_t max_len, size_t *to){
+    assert(dictionary);
+    assert(buffer);
+    assert(to);
+    assert(max_len >= 2 * VARINT_LEN);
+
+    if(from > dictionary->amount)
+        from = dictionary->amount;
+
+    // the amount of words comes first, so the words that fit are counted before anything is written
+    size_t amount = 0;
+    size_t words_len = 0;
+    while(from + amount < dictionary->amount){
+        size_t word_len = strlen(dictionary->words[from + amount]) + 1;
+        if(varint_len((uint32_t) from) + varint_len((uint32_t) amount + 1) + words_len + word_len > max_len)
+            break;
+        words_len += word_len;
+        amount++;
+    }
+
+    size_t len = varint_put(buffer, (uint32_t) from, WORD_ID_BYTE);
+    len += varint_put(&buffer[len], (uint32_t) amount, WORD_COUNT_BYTE);
+    for(size_t i=0; i<amount; i++){
+        size_t word_len = strlen(dictionary->words[from + i]);
+        memcpy(&buffer[len], dictionary->words[from + i], word_len);
+        len += word_len;
+        buffer[len++] = ' ';
+    }
+    *to = from + amount;
+    return len;
+}
+
+long word_dictionary_apply_update(word_dictionary *dictionary, const char *data, size_t len){
+    assert(dictionary);
+    assert(data || len == 0);
+
+    size_t pos = 0;
+    uint32_t from = 0;
+    uint32_t amount = 0;
+    if(!varint_get(data, len, &pos, WORD_ID_BYTE, &from) || !varint_get(data, len, &pos, WORD_COUNT_BYTE, &amount))
+        return -1;
+
+    for(uint32_t i=0; i<amount; i++){
+        size_t start = pos;
+        while(pos < len && is_alpha(data[pos]))
+            pos++;
+        if(pos == start || pos >= len || data[pos] != ' ' || pos - start >= WORD_ID_WORD_LEN)
+            return -1;
+
+        // words it has got already are skipped, after a gap (a lost update) nothing is taken
+        if((size_t) from + i == dictionary->amount && dictionary->amount < MAX_WORD_IDS){
+            char word[WORD_ID_WORD_LEN] = {0};
+            memcpy(word, &data[start], pos - start);
+            word_dictionary_add(dictionary, word);
+        }
+        pos++;
+    }
+    return (long) pos;
+}
+
+void word_dictionary_observe(word_dictionary *dictionary, const char *result, size_t len){
+    assert(dictionary);
+    assert(result || len == 0);
+
+    if(!dictionary->candidates)
+        dictionary->candidates = hashmap_init(CANDIDATE_BUCKETS, WORD_ID_WORD_LEN, sizeof(uint32_t), NULL, NULL);
+
+    size_t pos = 0;
+    const char *key;
+    size_t key_len;
+    uint32_t count;
+    while(dictionary->amount < MAX_WORD_IDS && word_ids_next_entry(result, len, &pos, &key, &key_len, &count)){
+        // a word that isn't longer than its ID would be doesn't get one
+        if(is_id_byte(key[0]) || key_len >= WORD_ID_WORD_LEN || key_len <= varint_len((uint32_t) dictionary->amount))
+            continue;
+
+        char word[WORD_ID_WORD_LEN] = {0};
+        memcpy(word, key, key_len);
+        if(word_dictionary_find(dictionary, word) >= 0)
+            continue;       // the worker didn't know the ID yet
+
+        uint32_t seen = 0;
+        hashmap_get(dictionary->candidates, word, &seen);
+        seen += count;
+        if(seen >= WORD_ID_MIN_COUNT){
+            word_dictionary_add(dictionary, word);
+            hashmap_remove(dictionary->candidates, word);
+        }
+        else{
+            hashmap_put(dictionary->candidates, word, &seen);
+        }
+    }
+}
+
+void word_dictionary_destroy(word_dictionary *dictionary){
+    assert(dictionary);
+    hashmap_destroy(dictionary->ids);
+    if(dictionary->candidates)
+        hashmap_destroy(dictionary->candidates);
+    free(dictionary->words);
+    free(dictionary);
+}
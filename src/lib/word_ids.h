@@ -0,0 +1,77 @@
+#pragma once
+
+// This header houses the word IDs of the dictionary mode (--dictionary)
+// the distributor gives frequent words a number (ID) and ships the new ones to the workers along with their MAP tasks,
+// the results of MAP and RED then carry the ID instead of the word and every count as a varint instead of ones/ digits
+// the messages stay NUL terminated strings, so a varint holds 5 bits per byte and its top bits tell what it is
+// (no byte is ever NUL or a letter):
+//   10mxxxxx   ID byte, m is set if another byte follows (least significant bits first)
+//   11mxxxxx   count byte, same
+// a result is a sequence of entries: the word (letters) or its ID, followed by its count ("and" 7 times -> "and\xC7")
+// an entry starts wherever a letter or an ID byte follows a count byte, that's where the chunker cuts the MAP results
+// a MAP task (MAP_IDS) starts with an update of the worker's dictionary, the text follows right behind it:
+//   <ID of the first word><amount of words (count varint)><word> <word> ... <word> <text>
+// the worker takes the words it hasn't got yet (an update that starts behind its last word is skipped) and its reply
+// starts with the amount of words it knows (ID varint), so the distributor knows which words it has to send next
+// a worker that doesn't know a word (yet) just sends the word, both are valid keys of the same word
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "./hashmap.h"
+
+#define WORD_ID_BYTE 0x80
+#define WORD_COUNT_BYTE 0xC0
+// set if another byte of the varint follows
+#define VARINT_MORE 0x20
+// a 32 bit varint takes at most this many bytes
+#define VARINT_LEN 7
+// words (with NUL) have to be shorter than this to get an ID, longer ones are rare and stay words
+#define WORD_ID_WORD_LEN 32
+// the dictionary doesn't grow beyond this many words (so an ID takes 3 bytes at most)
+#define MAX_WORD_IDS (1 << 15)
+// a word gets an ID once the MAP results counted it this often
+#define WORD_ID_MIN_COUNT 16
+
+typedef struct{
+    char (*words)[WORD_ID_WORD_LEN];    // by ID
+    size_t amount;
+    size_t capacity;
+    hashmap *ids;                       // word (char[WORD_ID_WORD_LEN]) -> ID (uint32_t)
+    hashmap *candidates;                // word -> count (uint32_t) of the words without ID (distributor only, NULL before)
+}word_dictionary;
+
+static inline bool is_id_byte(char c){
+    return ((unsigned char) c & 0xC0) == WORD_ID_BYTE;
+}
+
+static inline bool is_count_byte(char c){
+    return ((unsigned char) c & 0xC0) == WORD_COUNT_BYTE;
+}
+
+// writes the value as varint of the given kind (WORD_ID_BYTE or WORD_COUNT_BYTE), returns its length (at most VARINT_LEN)
+size_t varint_put(char *buffer, uint32_t value, unsigned char kind);
+// length of the varint of the value
+size_t varint_len(uint32_t value);
+// reads the varint of the given kind at data[*pos] and moves *pos behind it, returns false if there is none
+bool varint_get(const char *data, size_t len, size_t *pos, unsigned char kind, uint32_t *value);
+// reads the entry at data[*pos] and moves *pos behind it, *key points to the word or the ID bytes (key_len bytes)
+// returns false at the end of the data (a NUL ends it too) or if the entry is malformed (then *pos isn't at the end)
+bool word_ids_next_entry(const char *data, size_t len, size_t *pos, const char **key, size_t *key_len, uint32_t *count);
+
+word_dictionary* word_dictionary_init(void);
+// returns the ID of the word (NUL terminated) or -1 if it hasn't got one
+int64_t word_dictionary_find(word_dictionary *dictionary, const char *word);
+// returns the word with the ID or NULL if the dictionary hasn't got it
+const char* word_dictionary_word(word_dictionary *dictionary, uint32_t id);
+// gives the word the next ID, it mustn't have one yet and has to be shorter than WORD_ID_WORD_LEN (exits if it's full)
+uint32_t word_dictionary_add(word_dictionary *dictionary, const char *word);
+// writes an update with the words from ID from on (as many as fit into max_len bytes, at least 2 * VARINT_LEN)
+// returns the length of the update, *to is set to the ID behind its last word
+size_t word_dictionary_write_update(word_dictionary *dictionary, size_t from, char *buffer, size_t max_len, size_t *to);
+// adds the words of the update at the start of data that the dictionary hasn't got yet
+// returns the length of the update (the text starts behind it) or -1 if it is malformed
+long word_dictionary_apply_update(word_dictionary *dictionary, const char *data, size_t len);
+// counts the words (not the IDs) of a MAP result, the ones that have been counted WORD_ID_MIN_COUNT times get an ID
+// (as long as the ID is shorter than the word and the dictionary isn't full)
+void word_dictionary_observe(word_dictionary *dictionary, const char *result, size_t len);
+void word_dictionary_destroy(word_dictionary *dictionary);
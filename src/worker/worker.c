@@ -0,0 +1,722 @@
+#include <zmq.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include "./worker.h"
+#include "../lib/encoder.h"
+#include "../lib/hashmap.h"
+#include "../lib/linked_list.h"
+#include "../lib/shm_ring.h"
+#include "../lib/word_ids.h"
+
+// a worker that said bye gives up waiting for the RIP of the distributor after this many ms
+#define LEAVE_TIMEOUT_MS 10000
+
+static inline bool is_alpha(char c){
+    return (c>='a' && c<='z') || (c>='A' && c<='Z');
+}
+
+static inline int to_lower(int c){
+    if(c>='A' && c<='Z')
+        return c + 32;
+    return c;
+}
+
+static void append_one_to_result(char *buffer, void *key, void *value){
+    assert(buffer);
+    assert(key);
+    assert(value);
+
+    char *word = (char *) key;
+    int word_count = *(int *) value;
+
+    if(snprintf(buffer, MSG_LEN, "%s", word) < 0){
+        fprintf(stderr, "Could not append key-value pair to result buffer.\n");
+        exit(1);
+    }
+
+    for(int i=0; i<word_count; i++){
+        strcat(buffer, "1");
+    }
+}
+
+static void append_number_to_result(char *buffer, void *key, void *value){
+    assert(buffer);
+    assert(key);
+    assert(value);
+
+    char *word = (char *) key;
+    int word_count = *(int *) value;
+
+    if(snprintf(buffer, MSG_LEN, "%s", word) < 0){
+        fprintf(stderr, "Could not append key-value pair to result buffer.\n");
+        exit(1);
+    }
+
+    char number[10];        // should be enough
+    snprintf(number, sizeof(number), "%d", word_count);
+    strcat(buffer, number);
+}
+
+// MAP/ RED result with word IDs that is written entry by entry
+typedef struct{
+    char *buffer;
+    size_t len;
+    word_dictionary *dictionary;    // words that have got an ID (NULL for RED, the keys are written as they are)
+}id_result;
+
+// word or its ID and the count
+static void append_entry(void *key, void *value, void *arg){
+    id_result *result = (id_result *) arg;
+    const char *word = (const char *) key;
+    int64_t id = result->dictionary ? word_dictionary_find(result->dictionary, word) : -1;
+    if(id >= 0){
+        result->len += varint_put(&result->buffer[result->len], (uint32_t) id, WORD_ID_BYTE);
+    }
+    else{
+        size_t word_len = strlen(word);
+        memcpy(&result->buffer[result->len], word, word_len);
+        result->len += word_len;
+    }
+    result->len += varint_put(&result->buffer[result->len], (uint32_t) *(int *) value, WORD_COUNT_BYTE);
+    result->buffer[result->len] = '\0';
+}
+
+// counts the words of the string (in lowercase), returns a hashmap of word (char[MSG_LEN]) -> count (int)
+static hashmap* count_words_of(const char *string, size_t len){
+    hashmap *map = hashmap_init(10, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    char temp[MSG_LEN];
+    int word_end = 0;
+
+    for(size_t i=0; i<len && string[i] != '\0'; i++){
+        if(is_alpha(string[i])){
+            temp[word_end] = to_lower(string[i]);
+            word_end++;
+        }else if(word_end>0){
+            temp[word_end] = '\0';
+            word_end = 0;
+
+            int word_count = 1;
+            if(hashmap_contains(map, temp)){
+                hashmap_get(map, temp, &word_count);
+                word_count++;
+            }
+            
+            hashmap_put(map, temp, &word_count);
+        }
+    }
+
+    // last word might not have ended with a space
+    if(word_end > 0){
+        temp[word_end] = '\0';
+        int word_count = 1;
+        if(hashmap_contains(map, temp)){
+            hashmap_get(map, temp, &word_count);
+            word_count++;
+        }
+        hashmap_put(map, temp, &word_count);
+    }
+    return map;
+}
+
+// expects a buffer as result, so that the result can be copied into it
+// string doesn't have to be NUL terminated, it ends after len bytes (or at a NUL)
+static void map(const char *string, size_t len, char *result){
+    assert(string);
+    assert(result);
+
+    if(len == 0 || string[0] == '\0'){
+        result[0] = '\0';
+        return;
+    }
+
+    hashmap *map = count_words_of(string, len);
+    hashmap_to_string(map, result, append_one_to_result);
+
+    hashmap_destroy(map);
+    return;
+}
+
+// same as map, but every word is sent once with its count as a decimal number (like a RED result), so a frequent word
+// takes a few digits instead of a 1 per occurrence
+static void map_combined(const char *string, size_t len, char *result){
+    assert(string);
+    assert(result);
+
+    result[0] = '\0';
+    if(len == 0 || string[0] == '\0')
+        return;
+
+    hashmap *map = count_words_of(string, len);
+    hashmap_to_string(map, result, append_number_to_result);
+    hashmap_destroy(map);
+}
+
+// same as map, but the result starts with the amount of words the dictionary has got and every word is followed by its
+// count as varint, the words with an ID are replaced by it (see word_ids.h)
+static void map_ids(const char *string, size_t len, word_dictionary *dictionary, char *result){
+    assert(string);
+    assert(dictionary);
+    assert(result);
+
+    id_result ids = {result, 0, dictionary};
+    ids.len = varint_put(result, (uint32_t) dictionary->amount, WORD_ID_BYTE);
+    result[ids.len] = '\0';
+    if(len == 0 || string[0] == '\0')
+        return;
+
+    hashmap *map = count_words_of(string, len);
+    hashmap_for_each(map, append_entry, &ids);
+    hashmap_destroy(map);
+}
+
+static void reduce(const char *string, size_t len, char *result){
+    assert(string);
+    assert(result);
+
+    hashmap *map = hashmap_init(10, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+
+    char temp[MSG_LEN] = {0};
+    int word_end = 0;
+    int current_amount_of_ones = 0;
+    for(size_t i=0; i<len && string[i] != '\0'; i++){
+        if(is_alpha(string[i])){
+            if(current_amount_of_ones>0 && word_end>0){    // now encountered the next word
+                temp[word_end] = '\0';
+                
+                // this process could be optimized a little by adding a hashmap_increase_value function
+                int word_count = 0;
+                if(hashmap_contains(map, temp)){
+                    hashmap_get(map, temp, &word_count);
+                }
+
+                word_count += current_amount_of_ones;
+                hashmap_put(map, temp, &word_count);
+                word_end = 0;
+                current_amount_of_ones = 0;
+                memset(temp, 0, sizeof(temp));
+            }
+
+            // copy current word to temp
+            temp[word_end] = string[i];
+            word_end++;
+        }
+        else if(string[i] == '1')
+            current_amount_of_ones++;
+
+        else{
+            fprintf(stderr, "Invalid character in string on reduce function call.\n");
+            exit(1);
+        }
+    }
+
+    // doing the same stuff for the last word in the string
+    if(current_amount_of_ones>0 && word_end>0){
+        temp[word_end] = '\0';
+                
+        // this process could be optimized a little by adding a hashmap_increase_value function
+        int word_count = 0;
+        if(hashmap_contains(map, temp)){
+            hashmap_get(map, temp, &word_count);
+        }
+
+        word_count += current_amount_of_ones;
+        hashmap_put(map, temp, &word_count);
+    }
+
+    // again some POSIX conform bs
+    result[0] = '\0';
+    hashmap_to_string(map, result, append_number_to_result);
+
+    hashmap_destroy(map);
+}
+
+// same as reduce for MAP results with word IDs, a word and its ID are different keys (the distributor adds them up)
+static void reduce_ids(const char *string, size_t len, char *result){
+    assert(string);
+    assert(result);
+
+    hashmap *map = hashmap_init(10, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    char temp[MSG_LEN] = {0};
+    size_t pos = 0;
+    const char *key;
+    size_t key_len;
+    uint32_t count;
+    while(word_ids_next_entry(string, len, &pos, &key, &key_len, &count)){
+        memcpy(temp, key, key_len);
+        temp[key_len] = '\0';
+        int word_count = 0;
+        hashmap_get(map, temp, &word_count);
+        word_count += (int) count;
+        hashmap_put(map, temp, &word_count);
+    }
+    if(pos < len && string[pos] != '\0'){
+        fprintf(stderr, "Invalid entry in string on reduce function call.\n");
+        exit(1);
+    }
+
+    id_result ids = {result, 0, NULL};
+    result[0] = '\0';
+    hashmap_for_each(map, append_entry, &ids);
+    hashmap_destroy(map);
+}
+
+// merges RED results ("word3another2") into one table, the counts are decimal here (a node of the reduce tree)
+static void combine(const char *string, size_t len, char *result){
+    assert(string);
+    assert(result);
+
+    hashmap *map = hashmap_init(10, sizeof(char) * MSG_LEN, sizeof(int), NULL, NULL);
+    char temp[MSG_LEN] = {0};
+    size_t i = 0;
+    while(i < len && string[i] != '\0'){
+        size_t word_end = 0;
+        while(i < len && is_alpha(string[i]))
+            temp[word_end++] = string[i++];
+        temp[word_end] = '\0';
+
+        int amount = 0;
+        size_t digits = 0;
+        for(; i < len && string[i] >= '0' && string[i] <= '9'; i++, digits++)
+            amount = amount * 10 + (string[i] - '0');
+
+        // the distributor never cuts an entry (see MAP_COMBINED), a piece of one means the results are broken
+        if(word_end == 0 || digits == 0){
+            fprintf(stderr, "Invalid entry in string on combine function call.\n");
+            exit(1);
+        }
+        int word_count = 0;
+        hashmap_get(map, temp, &word_count);
+        word_count += amount;
+        hashmap_put(map, temp, &word_count);
+        memset(temp, 0, word_end);
+    }
+
+    result[0] = '\0';
+    hashmap_to_string(map, result, append_number_to_result);
+    hashmap_destroy(map);
+}
+
+// runs the task and writes its result into the buffer, an empty result if the task has no command
+// a MAP_IDS task starts with an update of the thread's dictionary (which is created with the first one)
+static void work_on(msg_view task, word_dictionary **dictionary, char *result){
+    result[0] = '\0';
+    if(task.type == MAP)
+        map(task.payload, task.len, result);
+    else if(task.type == RED)
+        reduce(task.payload, task.len, result);
+    else if(task.type == RED_IDS)
+        reduce_ids(task.payload, task.len, result);
+    else if(task.type == COMBINE)
+        combine(task.payload, task.len, result);
+    else if(task.type == MAP_COMBINED)
+        map_combined(task.payload, task.len, result);
+    else if(task.type == MAP_IDS){
+        if(!*dictionary)
+            *dictionary = word_dictionary_init();
+        long update_len = word_dictionary_apply_update(*dictionary, task.payload, task.len);
+        if(update_len < 0){
+            fprintf(stderr, "Invalid dictionary update. Answering with an empty result\n");
+            return;
+        }
+        map_ids(&task.payload[update_len], task.len - (size_t) update_len, *dictionary, result);
+    }
+}
+
+
+// shm://<name>: the tasks and results travel through a shared memory channel, the REP socket only gets the id of the task
+// (and RIP) and answers with the id of the result
+static void shm_worker(worker_data *worker){
+    const char *name = &worker->endpoint[strlen("shm:/")];     // keeps the '/' -> "/<name>"
+    char notify_endpoint[256];
+    if(shm_notify_endpoint(name, notify_endpoint, sizeof(notify_endpoint)) != 0){
+        fprintf(stderr, "No notification endpoint for shared memory %s\n", name);
+        return;
+    }
+
+    shm_channel *channel = shm_channel_create(name);
+    if(!channel){
+        fprintf(stderr, "Could not create shared memory %s: %s\n", name, strerror(errno));
+        return;
+    }
+
+    void *worker_socket = zmq_socket(worker->context, ZMQ_REP);
+    if(zmq_bind(worker_socket, notify_endpoint) != 0){
+        fprintf(stderr, "Could not bind to %s (ZMQ error): %s\n", notify_endpoint, zmq_strerror(zmq_errno()));
+        zmq_close(worker_socket);
+        goto close_channel;
+    }
+
+    word_dictionary *dictionary = NULL;
+    while(true){
+        char notification[32] = {0};
+        if(zmq_recv(worker_socket, notification, sizeof(notification)-1, 0) < 0)
+            break;
+        if(!strcmp(notification, "rip")){
+            zmq_send(worker_socket, "rip", 4, 0);
+            break;
+        }
+
+        // requests whose notification got lost (the distributor reset its socket) are skipped
+        uint64_t task_id = strtoull(notification, NULL, 10);
+        uint64_t id = 0;
+        long len = 0;
+        char msg_buff[MSG_LEN] = {0};
+        do{
+            len = shm_ring_read(&channel->requests, &id, msg_buff, MSG_LEN-1);
+        }while(len >= 0 && id != task_id);
+
+        char result_buff[MSG_LEN] = {0};
+        if(len >= 0){
+            msg_view task = decode_msg_view(msg_buff, len < MSG_LEN ? (size_t) len : MSG_LEN-1);
+            work_on(task, &dictionary, result_buff);
+        }
+        else{
+            fprintf(stderr, "Task %s is missing in the shared memory.\n", notification);
+        }
+
+        // the distributor drains the replies with every notification, so the ring can't be full
+        if(len < 0 || shm_ring_write(&channel->replies, task_id, result_buff, strlen(result_buff)+1) != 0)
+            snprintf(notification, sizeof(notification), "-");
+        zmq_send(worker_socket, notification, strlen(notification)+1, 0);
+    }
+
+    zmq_close(worker_socket);
+    if(dictionary)
+        word_dictionary_destroy(dictionary);
+
+    close_channel: ;
+    shm_channel_close(channel);
+    shm_channel_unlink(name);
+}
+
+void *worker_thread(void *data){
+    assert(data);
+    worker_data *worker = (worker_data *) data;
+    assert(worker->context);
+
+    if(!strncmp(worker->endpoint, "shm://", 6)){
+        shm_worker(worker);
+        pthread_exit(NULL);
+    }
+
+    void *worker_socket = zmq_socket(worker->context, ZMQ_REP);
+
+    int rc = zmq_bind(worker_socket, worker->endpoint);
+    if(rc != 0){
+        fprintf(stderr, "Could not bind to %s (ZMQ error): %s\n", worker->endpoint, zmq_strerror(zmq_errno()));
+        zmq_close(worker_socket);
+        pthread_exit(NULL);
+    }
+
+    word_dictionary *dictionary = NULL;
+    while(true){
+        // handle request, action, and response
+        // the payload is read right from the received message and the result (a reply has no command) is sent as is
+        char msg_buff[MSG_LEN] = {0};
+        char result_buff[MSG_LEN] = {0};
+        zmq_msg_t request;
+        zmq_msg_init(&request);
+        if(zmq_msg_recv(&request, worker_socket, 0) < 0){
+            zmq_msg_close(&request);
+            continue;
+        }
+
+        msg_view task = decode_msg_view((const char *) zmq_msg_data(&request), zmq_msg_size(&request));
+        switch(task.type){
+            case MAP:
+            case RED:
+            case MAP_IDS:
+            case RED_IDS:
+            case COMBINE:
+            case MAP_COMBINED:
+                work_on(task, &dictionary, result_buff);
+                zmq_msg_close(&request);
+                zmq_send(worker_socket, result_buff, strlen(result_buff)+1, 0);
+                break;
+            
+            case RIP:
+                zmq_msg_close(&request);
+                if(encode_msg(msg_buff, "", RIP) != 0){
+                    fprintf(stderr, "Couldn't encode rip message.\n");
+                    goto kill_worker_thread;
+                }
+                zmq_send(worker_socket, msg_buff, 4, 0);
+                goto kill_worker_thread;
+                break;
+            
+            default:
+                zmq_msg_close(&request);
+                fprintf(stderr, "No command found within the received message. Listening for next message\n");
+                break;
+        }
+    }
+
+    kill_worker_thread: ;      // not the cleanest way to do this, but it works
+
+    if(dictionary)
+        word_dictionary_destroy(dictionary);
+    zmq_close(worker_socket);
+    pthread_exit(NULL);
+}
+
+// ---- registered mode: the worker connects to a listening distributor (DEALER) and hands the tasks to a thread pool ----
+
+// dictionary of a registered worker, the main thread takes the updates in the order the tasks arrive and the threads
+// of the pool read it
+typedef struct{
+    word_dictionary *words;
+    pthread_rwlock_t lock;
+}shared_dictionary;
+
+typedef struct{
+    void *context;
+    int nr;
+    shared_dictionary *dictionary;
+}pool_data;
+
+typedef struct{
+    char id[32];            // task id of the distributor
+    int id_len;
+    char msg[MSG_LEN];
+}pending_task;
+
+static volatile sig_atomic_t leave_requested = 0;
+
+static void request_leave(int signal){
+    (void) signal;
+    leave_requested = 1;
+}
+
+static double now_ms(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// gets [task id][msg] from the main thread and answers with [task id][result], a single frame ends the thread
+static void *pool_thread(void *data){
+    assert(data);
+    pool_data *thread = (pool_data *) data;
+
+    char endpoint[64];
+    snprintf(endpoint, sizeof(endpoint), "inproc://pool%d", thread->nr);
+    void *socket = zmq_socket(thread->context, ZMQ_PAIR);
+    if(zmq_connect(socket, endpoint) != 0){
+        fprintf(stderr, "Could not connect to %s (ZMQ error): %s\n", endpoint, zmq_strerror(zmq_errno()));
+        zmq_close(socket);
+        pthread_exit(NULL);
+    }
+
+    while(true){
+        char id[32];
+        int id_len = zmq_recv(socket, id, sizeof(id), 0);
+        int more = 0;
+        size_t more_size = sizeof(more);
+        zmq_getsockopt(socket, ZMQ_RCVMORE, &more, &more_size);
+        if(id_len < 0 || !more)
+            break;
+
+        char result_buff[MSG_LEN] = {0};
+        zmq_msg_t request;
+        zmq_msg_init(&request);
+        zmq_msg_recv(&request, socket, 0);
+
+        // the main thread took the dictionary update off already
+        msg_view task = decode_msg_view((const char *) zmq_msg_data(&request), zmq_msg_size(&request));
+        if(task.type == MAP_IDS){
+            pthread_rwlock_rdlock(&thread->dictionary->lock);
+            map_ids(task.payload, task.len, thread->dictionary->words, result_buff);
+            pthread_rwlock_unlock(&thread->dictionary->lock);
+        }
+        else if(task.type == INVALID)
+            fprintf(stderr, "No command found within the received message. Answering with an empty result\n");
+        else
+            work_on(task, NULL, result_buff);
+
+        zmq_msg_close(&request);
+
+        zmq_send(socket, id, id_len, ZMQ_SNDMORE);
+        zmq_send(socket, result_buff, strlen(result_buff)+1, 0);
+    }
+
+    zmq_close(socket);
+    pthread_exit(NULL);
+}
+
+// takes the dictionary update off a MAP_IDS task ("mpi<update><text>" -> "mpi<text>"), every update is taken, even the one
+// of a task that is rejected, so the dictionary has every word the distributor has sent
+static void take_update(shared_dictionary *dictionary, char msg[]){
+    size_t len = strlen(msg);
+    if(decode_msg_view(msg, len).type != MAP_IDS)
+        return;
+
+    pthread_rwlock_wrlock(&dictionary->lock);
+    long update_len = word_dictionary_apply_update(dictionary->words, &msg[3], len - 3);
+    pthread_rwlock_unlock(&dictionary->lock);
+    if(update_len < 0){
+        fprintf(stderr, "Invalid dictionary update. Answering with an empty result\n");
+        msg[3] = '\0';
+        return;
+    }
+    memmove(&msg[3], &msg[3 + update_len], len - 3 - (size_t) update_len + 1);
+}
+
+// the worker buffers up to queue_len tasks on top of the ones its threads work on (see credits in scheduler.h)
+int run_registered_worker(void *context, const char *endpoint, int amount_of_threads, int queue_len){
+    void *dealer = zmq_socket(context, ZMQ_DEALER);
+    int linger = 0;
+    zmq_setsockopt(dealer, ZMQ_LINGER, &linger, sizeof(linger));
+    if(zmq_connect(dealer, endpoint) != 0){
+        fprintf(stderr, "Could not connect to %s (ZMQ error): %s\n", endpoint, zmq_strerror(zmq_errno()));
+        zmq_close(dealer);
+        return 1;
+    }
+
+    shared_dictionary dictionary = {word_dictionary_init(), PTHREAD_RWLOCK_INITIALIZER};
+    pthread_t threads[amount_of_threads];
+    pool_data thread_data[amount_of_threads];
+    void *pairs[amount_of_threads];
+    bool busy[amount_of_threads];
+    for(int i=0; i<amount_of_threads; i++){
+        char pair_endpoint[64];
+        snprintf(pair_endpoint, sizeof(pair_endpoint), "inproc://pool%d", i);
+        pairs[i] = zmq_socket(context, ZMQ_PAIR);
+        zmq_bind(pairs[i], pair_endpoint);      // bind before the thread connects
+        busy[i] = false;
+        thread_data[i].context = context;
+        thread_data[i].nr = i;
+        thread_data[i].dictionary = &dictionary;
+        pthread_create(&threads[i], NULL, pool_thread, &thread_data[i]);
+    }
+
+    // hey<threads> <host> <credits>
+    int credits = amount_of_threads + queue_len;
+    char host[128] = {0};
+    if(gethostname(host, sizeof(host)-1) != 0)
+        strcpy(host, "localhost");
+    char payload[MSG_LEN] = {0};
+    char msg_buff[MSG_LEN] = {0};
+    snprintf(payload, sizeof(payload), "%d %s %d", amount_of_threads, host, credits);
+    encode_msg(msg_buff, payload, HEY);
+    zmq_send(dealer, msg_buff, strlen(msg_buff)+1, 0);
+
+    signal(SIGINT, request_leave);
+    signal(SIGTERM, request_leave);
+
+    // tasks that wait for a thread, at most queue_len as long as the distributor sticks to the credits
+    list_head *pending = list_init(sizeof(pending_task));
+    int amount_of_pending_tasks = 0;
+    zmq_pollitem_t items[amount_of_threads + 1];
+    double left_at = -1;
+    bool dying = false;
+
+    while(true){
+        int amount_of_busy_threads = 0;
+        for(int i=0; i<amount_of_threads; i++)
+            amount_of_busy_threads += busy[i];
+        bool idle = amount_of_busy_threads == 0 && list_is_empty(pending);
+
+        if(dying && idle)
+            break;
+        if(leave_requested && left_at < 0){
+            encode_msg(msg_buff, "", BYE);
+            zmq_send(dealer, msg_buff, strlen(msg_buff)+1, 0);
+            left_at = now_ms();
+        }
+        if(left_at >= 0 && idle && now_ms() - left_at > LEAVE_TIMEOUT_MS){
+            fprintf(stderr, "Distributor did not answer the bye, leaving anyways.\n");
+            break;
+        }
+
+        items[0] = (zmq_pollitem_t){dealer, 0, ZMQ_POLLIN, 0};
+        for(int i=0; i<amount_of_threads; i++)
+            items[i+1] = (zmq_pollitem_t){pairs[i], 0, ZMQ_POLLIN, 0};
+        if(zmq_poll(items, amount_of_threads + 1, 100) < 0 && zmq_errno() != EINTR)
+            break;
+
+        if(items[0].revents & ZMQ_POLLIN){
+            pending_task task = {0};
+            task.id_len = zmq_recv(dealer, task.id, sizeof(task.id), 0);
+            int more = 0;
+            size_t more_size = sizeof(more);
+            zmq_getsockopt(dealer, ZMQ_RCVMORE, &more, &more_size);
+
+            if(!more){
+                // control message without task id, the only one sent to a worker is RIP
+                task.id[sizeof(task.id)-1] = '\0';
+                if(!strncmp(task.id, "rip", 3))
+                    dying = true;
+            }
+            else if(task.id_len > 0 && task.id_len <= (int) sizeof(task.id)){
+                // [command][chunk] -> "map..."/ "red..." (the chunk isn't NUL terminated)
+                int len = zmq_recv(dealer, task.msg, 3, 0);
+                zmq_getsockopt(dealer, ZMQ_RCVMORE, &more, &more_size);
+                if(len == 3 && more){
+                    len = zmq_recv(dealer, &task.msg[3], MSG_LEN-4, 0);
+                    task.msg[3 + (len < 0 ? 0 : (len < MSG_LEN-4 ? len : MSG_LEN-4))] = '\0';
+                }
+                take_update(&dictionary, task.msg);
+
+                // out of credit -> reject with an empty result frame, so the distributor gets its credit back
+                if(amount_of_busy_threads + amount_of_pending_tasks >= credits){
+                    zmq_send(dealer, task.id, task.id_len, ZMQ_SNDMORE);
+                    zmq_send(dealer, "", 0, 0);
+                }
+                else{
+                    list_insert_back(pending, &task);
+                    amount_of_pending_tasks++;
+                }
+            }
+        }
+
+        // forward the results of the threads
+        for(int i=0; i<amount_of_threads; i++){
+            if(!(items[i+1].revents & ZMQ_POLLIN))
+                continue;
+            char id[32];
+            int id_len = zmq_recv(pairs[i], id, sizeof(id), 0);
+            zmq_recv(pairs[i], msg_buff, MSG_LEN, 0);
+            msg_buff[MSG_LEN-1] = '\0';
+            zmq_send(dealer, id, id_len, ZMQ_SNDMORE);
+            zmq_send(dealer, msg_buff, strlen(msg_buff)+1, 0);
+            busy[i] = false;
+        }
+
+        // hand waiting tasks to idle threads
+        for(int i=0; i<amount_of_threads && !list_is_empty(pending); i++){
+            if(busy[i])
+                continue;
+            pending_task task;
+            list_remove_front(pending, &task);
+            amount_of_pending_tasks--;
+            zmq_send(pairs[i], task.id, task.id_len, ZMQ_SNDMORE);
+            zmq_send(pairs[i], task.msg, strlen(task.msg)+1, 0);
+            busy[i] = true;
+        }
+    }
+
+    // acknowledge the RIP and shut the pool down
+    if(dying){
+        encode_msg(msg_buff, "", RIP);
+        zmq_send(dealer, msg_buff, 4, 0);
+    }
+    for(int i=0; i<amount_of_threads; i++){
+        zmq_send(pairs[i], "rip", 4, 0);
+        pthread_join(threads[i], NULL);
+        zmq_close(pairs[i]);
+    }
+
+    list_destroy(pending);
+    word_dictionary_destroy(dictionary.words);
+    pthread_rwlock_destroy(&dictionary.lock);
+    zmq_close(dealer);
+    return 0;
+}
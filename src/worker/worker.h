@@ -0,0 +1,17 @@
+#pragma once
+
+// This header houses the worker itself, so it can run in its own process (see main.c) or as threads of the distributor
+// a worker thread binds a REP socket (or a shm:// channel) and answers map/ reduce requests until it gets RIP
+// a registered worker connects to a listening distributor instead and works through a thread pool
+#define WORKER_ENDPOINT_LEN 256
+
+typedef struct{
+    void *context;
+    char endpoint[WORKER_ENDPOINT_LEN];     // zmq endpoint the worker binds to
+}worker_data;
+
+// pthread start routine, expects a worker_data (which has to outlive the thread)
+void *worker_thread(void *data);
+// registers at the distributor and works until it sends RIP (SIGINT/ SIGTERM make the worker say bye first)
+// the worker buffers up to queue_len tasks on top of the ones its threads work on, returns 0 on success
+int run_registered_worker(void *context, const char *endpoint, int amount_of_threads, int queue_len);
@@ -7,9 +7,14 @@ from collections import Counter
 from sys import stderr
 
 import numpy as np
+import os
 import pytest
+import re
+import shutil
+import struct
 import subprocess
 import sys
+import threading
 import time
 import util
 import zmq
@@ -409,6 +414,601 @@ def test_load_distribution(program_args):
         assert std <= 2
 
 
+@pytest.mark.timeout(60)
+def test_combine_long_words(program_args):
+    # words longer than a message are split into pieces, with --combine every piece has to keep its count
+    # (the distributor used to cut a piece off its count, which made the workers exit)
+    filename = test_args["filename_long_words"]
+    base_port = test_args["base_port"]
+
+    long_words = ["".join(np.random.choice(list("abc"), length)) for length in [1400, 1495, 1496, 1497, 3000, 4000]]
+    text = " ".join(["short words between long ones"] * 50 + long_words * 3 + ["the end"])
+    f = open(filename, "w")
+    f.write(text)
+    f.close()
+
+    port_list = [str(base_port), str(base_port + 1)]
+    for options in [["--combine"], ["--combine", "--tree", "1"]]:
+        # kill any zmq procs currently running
+        util.kill_zmq_distributor_and_worker()
+
+        worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+        proc_distributor = util.start_distributor([test_args["distributor"]] + options + [filename] + port_list)
+
+        util.join_workers(worker_procs)
+
+        distributor_output, distributor_err = proc_distributor.communicate()
+        assert proc_distributor.returncode == 0, f"distributor with {options} failed on long words."
+
+        # the short words are counted as usual and no letter of the long ones is lost
+        counts = dict(line.split(",") for line in distributor_output.split("\n")[1:] if line)
+        correct = dict(line.split(",") for line in util.count_words(text).split("\n")[1:] if line)
+        for word, count in correct.items():
+            if len(word) < 100:
+                assert counts.get(word) == count, f"{word} miscounted with {options}."
+        letters = sum(len(word) * int(count) for word, count in counts.items())
+        assert letters == sum(len(word) * int(count) for word, count in correct.items()), f"letters lost with {options}."
+
+
+def count_with_options(options, filename, num_workers=2):
+    # runs a count of the file with the distributor options, returns its output, its errors and its return code
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + num_workers)]
+
+    # kill any zmq procs currently running
+    util.kill_zmq_distributor_and_worker()
+
+    worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+    proc_distributor = util.start_distributor([test_args["distributor"]] + options + [filename] + port_list,
+                                              stderr=subprocess.PIPE)
+
+    util.join_workers(worker_procs)
+
+    distributor_output, distributor_err = proc_distributor.communicate()
+    return distributor_output, distributor_err, proc_distributor.returncode
+
+
+def parse_counts(output):
+    return dict(line.split(",") for line in output.split("\n")[1:] if line)
+
+
+@pytest.mark.timeout(60)
+def test_dictionary_long_words(program_args):
+    # a MAP_IDS task needs room for the dictionary update besides its chunk, a long word must neither be cut off for it
+    # nor take the room away, words up to 1482 letters stay whole, longer ones are split (no letter is lost)
+    filename = test_args["filename_long_words"]
+
+    long_words = ["".join(np.random.choice(list("abc"), length)) for length in [1400, 1482, 1490, 1495, 3000]]
+    text = " ".join(["short words between long ones"] * 2000 + long_words * 3 + ["the end"])
+    f = open(filename, "w")
+    f.write(text)
+    f.close()
+
+    distributor_output, distributor_err, returncode = count_with_options(["--dictionary"], filename)
+    assert returncode == 0, "distributor with --dictionary failed on long words."
+
+    counts = parse_counts(distributor_output)
+    correct = parse_counts(util.count_words(text))
+    for word, count in correct.items():
+        if len(word) <= 1482:
+            assert counts.get(word) == count, f"word of {len(word)} letters miscounted with --dictionary."
+    letters = sum(len(word) * int(count) for word, count in counts.items())
+    assert letters == sum(len(word) * int(count) for word, count in correct.items()), "letters lost with --dictionary."
+
+
+@pytest.mark.timeout(60)
+def test_state(program_args):
+    # a run with a state only counts what has been appended since the last one, an edit in front of that is noticed
+    # (even together with an append) and the file is counted again from the start
+    filename = test_args["filename_state"]
+    state = test_args["filename_state_saved"]
+    word_list = util.get_part_of_word_list(test_args["word_list"], 500)
+    parts = [util.generate_text_from_word_list(word_list, test_args["simple_delimiters"], 200e3) for i in range(3)]
+
+    if os.path.isfile(state):
+        os.remove(state)
+    f = open(filename, "w")
+    f.write(parts[0])
+    f.close()
+    distributor_output, distributor_err, returncode = count_with_options(["--state", state], filename)
+    assert returncode == 0 and distributor_output == util.count_words(parts[0]), "first run with --state failed."
+
+    # append -> only the new part is counted, the counts are those of the whole file
+    f = open(filename, "a")
+    f.write(parts[1])
+    f.close()
+    distributor_output, distributor_err, returncode = count_with_options(["--state", state], filename)
+    assert "everything is counted" not in distributor_err, "state wasn't used after an append."
+    assert distributor_output == util.count_words(parts[0] + parts[1]), "counts after an append are wrong."
+
+    # in-place edit in the middle of the counted part together with an append -> everything is counted again
+    f = open(filename, "r+")
+    f.seek(len(parts[0]))
+    f.write("edited" * 10)
+    f.seek(0, 2)
+    f.write(parts[2])
+    f.close()
+    f = open(filename, "r")
+    text = f.read()
+    f.close()
+    distributor_output, distributor_err, returncode = count_with_options(["--state", state], filename)
+    assert "everything is counted" in distributor_err, "in-place edit wasn't noticed."
+    assert distributor_output == util.count_words(text), "counts after an in-place edit are wrong."
+
+    # in-place edit without an append -> everything is counted again
+    f = open(filename, "r+")
+    f.seek(len(text) // 3)
+    f.write("again" * 10)
+    f.close()
+    f = open(filename, "r")
+    text = f.read()
+    f.close()
+    distributor_output, distributor_err, returncode = count_with_options(["--state", state], filename)
+    assert "everything is counted" in distributor_err, "in-place edit wasn't noticed."
+    assert distributor_output == util.count_words(text), "counts after an in-place edit are wrong."
+    os.remove(state)
+
+
+@pytest.mark.timeout(60)
+def test_chunk_cache(program_args):
+    # the second run over the same file finds every chunk in the cache and still prints the same counts
+    filename = test_args["filename_complex"]
+    cache_dir = test_args["dirname_chunk_cache"]
+    f = open(filename, "r")
+    correct_word_count = util.count_words(f.read())
+    f.close()
+
+    shutil.rmtree(cache_dir, ignore_errors=True)
+    for run in range(2):
+        distributor_output, distributor_err, returncode = count_with_options(["--cache", cache_dir], filename)
+        assert returncode == 0 and distributor_output == correct_word_count, f"run {run + 1} with --cache failed."
+
+    stats = re.search("Chunk cache: ([0-9]+) hits, ([0-9]+) misses", distributor_err)
+    assert stats and int(stats.group(1)) > 0 and int(stats.group(2)) == 0, "second run with --cache missed chunks."
+    shutil.rmtree(cache_dir, ignore_errors=True)
+
+
+@pytest.mark.timeout(60)
+def test_dying_worker(program_args):
+    # a worker that dies in the middle of a job loses its task, the task times out and goes to another worker
+    # (the dead one is evicted once it missed three requests) and the count is still complete
+    filename = test_args["filename_dying_worker"]
+    book_text = test_args["books"][0]
+    file_out = open(filename, "wb")
+    file_out.write(book_text)
+    file_out.close()
+
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 3)]
+
+    # kill any zmq procs currently running
+    util.kill_zmq_distributor_and_worker()
+
+    worker_procs = util.start_threaded_workers(test_args["worker"], port_list[:2])
+    dying_worker = multiprocessing.Process(target=util.run_dying_worker, args=(port_list[2],))
+    dying_worker.start()
+    proc_distributor = util.start_distributor([test_args["distributor"], "--timeout", "300", filename] + port_list,
+                                              stderr=subprocess.PIPE)
+
+    util.join_workers(worker_procs + [dying_worker])
+    distributor_output, distributor_err = proc_distributor.communicate()
+
+    assert proc_distributor.returncode == 0, "distributor failed after a worker died."
+    assert "timed out" in distributor_err, "the task of the dead worker didn't time out."
+    assert distributor_output == util.count_words(book_text.decode("ascii", errors="ignore")), \
+        "count incomplete after a worker died."
+
+
+def apply_window_changes(output):
+    # replays the published changes, returns the top words of every window (word -> count) in order
+    windows = []
+    for line in output.split("\n"):
+        if line.startswith("window "):
+            assert int(line.split(" ")[1]) == len(windows) + 1, "windows aren't numbered consecutively."
+            windows.append(dict(windows[-1]) if windows else {})
+        elif line.startswith("-"):
+            windows[-1].pop(line[1:])
+        elif line:
+            word, count = line.split(",")
+            windows[-1][word] = int(count)
+    return windows
+
+
+@pytest.mark.timeout(60)
+def test_window(program_args):
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 2)]
+
+    # a window has to consist of whole slides
+    for options in [["--window", "1", "--slide", "0.3"], ["--window", "1", "--slide", "2"]]:
+        proc_distributor = subprocess.Popen([test_args["distributor"]] + options + ["-"] + port_list, stdin=subprocess.DEVNULL,
+                                            stdout=subprocess.PIPE, stderr=subprocess.PIPE, encoding="ascii")
+        distributor_output, distributor_err = proc_distributor.communicate()
+        assert proc_distributor.returncode != 0, f"{options} should be rejected."
+
+    # kill any zmq procs currently running
+    util.kill_zmq_distributor_and_worker()
+
+    # two bursts of text with a pause that is longer than a window in between, the second one pushes the first one out
+    worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+    proc_distributor = subprocess.Popen([test_args["distributor"], "--window", "0.4", "--slide", "0.2", "--top", "3", "-"] + port_list,
+                                        stdin=subprocess.PIPE, stdout=subprocess.PIPE, encoding="ascii")
+    proc_distributor.stdin.write("Alpha alpha, alpha beta\n")
+    proc_distributor.stdin.flush()
+    time.sleep(1.5)
+    proc_distributor.stdin.write("beta beta beta gamma beta beta\n")
+    proc_distributor.stdin.flush()
+    time.sleep(1.5)
+    proc_distributor.stdin.close()
+
+    util.join_workers(worker_procs)
+    distributor_output = proc_distributor.stdout.read()
+    proc_distributor.wait()
+    assert proc_distributor.returncode == 0, "distributor failed in windowed mode."
+
+    windows = apply_window_changes(distributor_output)
+    first = [i for i, top in enumerate(windows) if top == {"alpha": 3, "beta": 1}]
+    second = [i for i, top in enumerate(windows) if top == {"beta": 5, "gamma": 1}]
+    assert first, "the first burst isn't counted in a window of its own."
+    assert second and second[0] > first[0], "the second burst isn't counted in a window of its own."
+    assert windows[-1] == {}, "the text doesn't leave the window once it's over."
+
+
+def write_text(path, text):
+    f = open(path, "w")
+    f.write(text)
+    f.close()
+
+
+@pytest.mark.timeout(60)
+def test_directories_and_globs(program_args):
+    # a directory is counted with every file within it (recursively), a glob pattern with every file it matches and --input
+    # adds more inputs, the small files are packed together, but a word never continues from one file into the next
+    input_dir = test_args["dirname_inputs"]
+    shutil.rmtree(input_dir, ignore_errors=True)
+    os.makedirs(os.path.join(input_dir, "books", "more"))
+    os.makedirs(os.path.join(input_dir, "small"))
+
+    texts = []
+    for i, book in enumerate(test_args["books"]):
+        text = book.decode("ascii", errors="ignore")
+        write_text(os.path.join(input_dir, "books", "more" if i else "", f"book{i}.txt"), text)
+        texts.append(text)
+    for i in range(300):
+        text = util.generate_text_from_word_list(test_args["word_list"], test_args["simple_delimiters"], 200).strip()
+        write_text(os.path.join(input_dir, "small", f"{i}.txt"), text)
+        texts.append(text)
+    write_text(os.path.join(input_dir, "small", "empty.txt"), "")
+    write_text(os.path.join(input_dir, "small", "skipped.log"), "notmatched")
+
+    options = ["--readers", "3", "--input", os.path.join(input_dir, "small", "*.txt")]
+    distributor_output, distributor_err, returncode = count_with_options(options, os.path.join(input_dir, "books"), 4)
+    assert returncode == 0, "distributor failed on a directory and a glob pattern."
+    assert distributor_output == util.count_words("\n".join(texts)), "directory and glob pattern counted wrong."
+
+    # a pattern that doesn't match anything is an error (before any worker is contacted)
+    proc_distributor = util.start_distributor([test_args["distributor"], os.path.join(input_dir, "*.none"),
+                                               str(test_args["base_port"])], stderr=subprocess.PIPE)
+    proc_distributor.communicate()
+    assert proc_distributor.returncode != 0, "a pattern without a match has been accepted."
+    shutil.rmtree(input_dir, ignore_errors=True)
+
+
+@pytest.mark.timeout(90)
+def test_file_ranges(program_args):
+    # a file beyond RANGE_LEN (16 MiB, see chunker.h) is split into ranges that are read in parallel, every reader moves the
+    # start of its range to the next word, so the word across the border is counted once and as a whole
+    filename = test_args["filename_ranges"]
+    range_len = 16 << 20
+    books = "\n".join(book.decode("ascii", errors="ignore") for book in test_args["books"])
+    text = "\n".join([books] * (range_len // len(books) + 2))
+    text = text[:range_len - 7] + " rangeborder " + text[range_len - 7:]
+    write_text(filename, text)
+
+    distributor_output, distributor_err, returncode = count_with_options(["--readers", "2"], filename, 4)
+    assert returncode == 0, "distributor failed on a file with several ranges."
+    assert distributor_output == util.count_words(text), "file with several ranges counted wrong."
+    assert "rangeborder,1\n" in distributor_output, "the word across the border of the ranges has been split."
+
+
+@pytest.mark.timeout(90)
+def test_big_files(program_args):
+    # files of at least half a segment (SEGMENT_LEN, see chunker.h) are read with io_uring (if the kernel allows it, they are
+    # mapped otherwise) in pieces of ASYNC_READ_LEN (1 MiB, see async_reader.h), the last piece of a file is a short one
+    input_dir = test_args["dirname_inputs"]
+    shutil.rmtree(input_dir, ignore_errors=True)
+    os.makedirs(input_dir)
+
+    books = "\n".join(book.decode("ascii", errors="ignore") for book in test_args["books"])
+    texts = []
+    for i, size in enumerate([600 * 1000, (1 << 20) - 1, 1 << 20, (1 << 20) + 1, 2500 * 1000]):
+        text = (books * (size // len(books) + 1))[:size]
+        write_text(os.path.join(input_dir, f"{i}.txt"), text)
+        texts.append(text)
+
+    distributor_output, distributor_err, returncode = count_with_options(["--readers", "3"], input_dir, 4)
+    assert returncode == 0, "distributor failed on big files."
+    assert distributor_output == util.count_words("\n".join(texts)), "big files counted wrong."
+    shutil.rmtree(input_dir, ignore_errors=True)
+
+
+@pytest.mark.timeout(60)
+def test_stdin(program_args):
+    # "-" reads the text from a pipe, it arrives in pieces that end in the middle of a word (the partial word is carried
+    # over to the next segment), the size isn't known in advance
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 4)]
+    text = "\n".join(book.decode("ascii", errors="ignore") for book in test_args["books"])
+
+    # kill any zmq procs currently running
+    util.kill_zmq_distributor_and_worker()
+
+    worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+    proc_distributor = subprocess.Popen([test_args["distributor"], "-"] + port_list, stdin=subprocess.PIPE,
+                                        stdout=subprocess.PIPE, encoding="ascii")
+    pieces = [text[i:i + 300 * 1000] for i in range(0, len(text), 300 * 1000)]
+    for piece in pieces[:-1] + ["partial wo", "rd at the end"]:
+        proc_distributor.stdin.write(piece)
+        proc_distributor.stdin.flush()
+        time.sleep(0.05)
+    proc_distributor.stdin.write(pieces[-1])
+    proc_distributor.stdin.close()
+
+    util.join_workers(worker_procs)
+    distributor_output = proc_distributor.stdout.read()
+    proc_distributor.wait()
+    assert proc_distributor.returncode == 0, "distributor failed on stdin."
+    assert distributor_output == util.count_words("".join(pieces[:-1]) + "partial word at the end" + pieces[-1]), \
+        "stdin counted wrong."
+
+    # stdin can't be combined with other inputs (before any worker is contacted)
+    proc_distributor = util.start_distributor([test_args["distributor"], "--input", test_args["filename_simple"], "-",
+                                               port_list[0]], stderr=subprocess.PIPE)
+    proc_distributor.communicate()
+    assert proc_distributor.returncode != 0, "stdin has been combined with a file."
+
+
+def start_job_server(input_dir, port_list, serve_port):
+    # kill any zmq procs currently running
+    util.kill_zmq_distributor_and_worker()
+
+    worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+    proc_distributor = util.start_distributor([test_args["distributor"], "--serve", f"tcp://127.0.0.1:{serve_port}",
+                                               "--root", input_dir] + port_list)
+    return worker_procs, proc_distributor
+
+
+def job_request(frames, serve_port):
+    # sends a request to the job server and returns the frames of its reply (as strings)
+    socket = zmq.Context.instance().socket(zmq.REQ)
+    socket.setsockopt(zmq.RCVTIMEO, 30000)
+    socket.setsockopt(zmq.LINGER, 0)
+    socket.connect(f"tcp://127.0.0.1:{serve_port}")
+    socket.send_multipart([frame.encode("ascii") for frame in frames])
+    reply = [frame.decode("ascii") for frame in socket.recv_multipart()]
+    socket.close()
+    return reply
+
+
+@pytest.mark.timeout(60)
+def test_job_server(program_args):
+    # the job server counts one request after the other with the same workers, the files of a count request have to be
+    # within the root, the workers only get their RIP once the server is shut down
+    input_dir = os.path.abspath(test_args["dirname_inputs"])
+    shutil.rmtree(input_dir, ignore_errors=True)
+    os.makedirs(os.path.join(input_dir, "books"))
+    texts = [book.decode("ascii", errors="ignore") for book in test_args["books"]]
+    for i, text in enumerate(texts):
+        write_text(os.path.join(input_dir, "books", f"book{i}.txt"), text)
+    write_text(test_args["filename_simple"] + ".outside", "outside")
+
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 2)]
+    serve_port = test_args["base_port"] + 10
+    worker_procs, proc_distributor = start_job_server(input_dir, port_list, serve_port)
+
+    assert job_request(["count", "books/book0.txt"], serve_port) == ["ok", util.count_words(texts[0])], \
+        "count request of a file failed."
+    assert job_request(["count", "books"], serve_port) == ["ok", util.count_words("\n".join(texts))], \
+        "count request of a directory failed."
+    assert job_request(["text", "The text, the TEXT itself."], serve_port) == ["ok", "word,frequency\ntext,2\nthe,2\nitself,1\n"], \
+        "text request failed."
+    for path in ["missing.txt", "../" + test_args["filename_simple"] + ".outside",
+                 os.path.abspath(test_args["filename_simple"] + ".outside")]:
+        assert job_request(["count", path], serve_port)[0] == "error", f"count request of {path} didn't fail."
+
+    assert job_request(["shutdown"], serve_port)[0] == "ok", "shutdown request failed."
+    util.join_workers(worker_procs)
+    proc_distributor.communicate()
+    assert proc_distributor.returncode == 0, "job server failed."
+    os.remove(test_args["filename_simple"] + ".outside")
+    shutil.rmtree(input_dir, ignore_errors=True)
+
+
+@pytest.mark.timeout(60)
+def test_concurrent_jobs(program_args):
+    # jobs run at once and share the workers, a small job doesn't wait for a big one that started before it,
+    # every job gets its own counts
+    input_dir = os.path.abspath(test_args["dirname_inputs"])
+    shutil.rmtree(input_dir, ignore_errors=True)
+    os.makedirs(input_dir)
+    texts = [book.decode("ascii", errors="ignore") for book in test_args["books"]]
+    for i, text in enumerate(texts):
+        write_text(os.path.join(input_dir, f"book{i}.txt"), text)
+
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 2)]
+    serve_port = test_args["base_port"] + 10
+    worker_procs, proc_distributor = start_job_server(input_dir, port_list, serve_port)
+
+    small_text = util.generate_text_from_word_list(test_args["word_list"], test_args["all_delimiters"], 5000)
+    jobs = [(["count", "."], util.count_words("\n".join(texts)))] + \
+           [([f"count:{i + 1}", f"book{i}.txt"], util.count_words(text)) for i, text in enumerate(texts)] + \
+           [(["text:4", small_text], util.count_words(small_text))]
+    replies = {}
+    finished = []
+
+    def run_job(nr):
+        replies[nr] = job_request(jobs[nr][0], serve_port)
+        finished.append(nr)
+
+    threads = []
+    for nr in range(len(jobs)):
+        threads.append(threading.Thread(target=run_job, args=(nr,)))
+        threads[-1].start()
+        if nr == 0:
+            time.sleep(0.2)     # the big job is already running
+    for thread in threads:
+        thread.join()
+
+    for nr, (request, correct_word_count) in enumerate(jobs):
+        assert replies[nr] == ["ok", correct_word_count], f"concurrent job {request[0]} {request[1][:20]} counted wrong."
+    assert finished[-1] == 0, "the big job didn't share the workers with the small ones."
+    assert job_request(["count:0", "book0.txt"], serve_port)[0] == "error", "a priority of 0 has been accepted."
+
+    assert job_request(["shutdown"], serve_port)[0] == "ok", "shutdown request failed."
+    util.join_workers(worker_procs)
+    proc_distributor.communicate()
+    assert proc_distributor.returncode == 0, "job server failed."
+    shutil.rmtree(input_dir, ignore_errors=True)
+
+
+def read_result_index(filename):
+    # parses the binary result file (layout see result_index.h), returns the words (sorted), their counts, the ranks and
+    # the hash index
+    f = open(filename, "rb")
+    data = f.read()
+    f.close()
+
+    magic, amount, buckets, total, counts_offset, offsets_offset, ranks_offset, index_offset, words_offset, size = \
+        struct.unpack_from("<8s9Q", data, 0)
+    assert magic == b"ZMQWCIX1" and size == len(data), "invalid header of the result file."
+    for offset in [counts_offset, offsets_offset, ranks_offset, index_offset, words_offset]:
+        assert offset % 8 == 0, "section of the result file isn't aligned."
+
+    counts = struct.unpack_from(f"<{amount}Q", data, counts_offset)
+    offsets = struct.unpack_from(f"<{amount}Q", data, offsets_offset)
+    ranks = struct.unpack_from(f"<{amount}I", data, ranks_offset)
+    index = struct.unpack_from(f"<{buckets}I", data, index_offset)
+    words = []
+    for offset in offsets:
+        length = struct.unpack_from("<H", data, words_offset + offset)[0]
+        start = words_offset + offset + 2
+        assert data[start + length] == 0, "word in the result file isn't NUL terminated."
+        words.append(data[start:start + length].decode("ascii"))
+    assert sum(counts) == total, "total of the result file is wrong."
+    return words, counts, ranks, index
+
+
+def find_in_result_index(index, words, word):
+    # FNV-1a of the word's bytes, linear probing
+    hash = 0xcbf29ce484222325
+    for byte in word.encode("ascii"):
+        hash = ((hash ^ byte) * 0x100000001b3) & 0xffffffffffffffff
+    bucket = hash & (len(index) - 1)
+    while index[bucket] != 0:
+        if words[index[bucket] - 1] == word:
+            return index[bucket] - 1
+        bucket = (bucket + 1) % len(index)
+    return -1
+
+
+@pytest.mark.timeout(60)
+def test_result_index(program_args):
+    # --index writes the counts to a binary file as well, it has to hold the same counts as the csv, the words sorted,
+    # the ranks in the order of the csv and every word has to be found through the hash index
+    filename = test_args["filename_book_1"]
+    index_file = test_args["filename_index"]
+    book_text = test_args["books"][0]
+    file_out = open(filename, "wb")
+    file_out.write(book_text)
+    file_out.close()
+
+    distributor_output, distributor_err, returncode = count_with_options(["--index", index_file], filename)
+    correct_word_count = util.count_words(book_text.decode("ascii", errors="ignore"))
+    assert returncode == 0 and distributor_output == correct_word_count, "count with --index failed."
+
+    words, counts, ranks, index = read_result_index(index_file)
+    assert words == sorted(words), "words of the result file aren't sorted."
+    csv = [line.split(",") for line in correct_word_count.split("\n")[1:] if line]
+    assert [[words[nr], str(counts[nr])] for nr in ranks] == csv, "ranks of the result file differ from the csv."
+    for nr, word in enumerate(words):
+        assert find_in_result_index(index, words, word) == nr, f"{word} can't be found through the hash index."
+    assert find_in_result_index(index, words, "xnotawordx") == -1, "a missing word has been found in the hash index."
+
+
+def query(frames, query_port):
+    # sends a batch of queries to the query service and returns the frames of its reply (as strings)
+    socket = zmq.Context.instance().socket(zmq.REQ)
+    socket.setsockopt(zmq.RCVTIMEO, 30000)
+    socket.setsockopt(zmq.LINGER, 0)
+    socket.connect(f"tcp://127.0.0.1:{query_port}")
+    socket.send_multipart([frame.encode("ascii") for frame in frames])
+    reply = [frame.decode("ascii") for frame in socket.recv_multipart()]
+    socket.close()
+    return reply
+
+
+@pytest.mark.timeout(60)
+def test_query(program_args):
+    # --query answers lookups of the result once the count is done (the workers get their RIP before), without a file it
+    # answers from the --index of an earlier run, every query of a batch gets its own frame in the reply
+    filename = test_args["filename_book_1"]
+    index_file = test_args["filename_index"]
+    book_text = test_args["books"][0]
+    file_out = open(filename, "wb")
+    file_out.write(book_text)
+    file_out.close()
+
+    correct_word_count = util.count_words(book_text.decode("ascii", errors="ignore"))
+    counts = parse_counts(correct_word_count)
+    csv = correct_word_count.split("\n")[1:]
+    word = csv[0].split(",")[0]
+    prefix = "".join(w + "," + counts[w] + "\n" for w in sorted(counts) if w.startswith(word[:2]))
+    queries = [f"get {word}", f"get {word.upper()}", "get xnotawordx", f"prefix {word[:2]}", f"prefix {word[:2]} 2",
+               "prefix xnotawordx", "top 5", "bogus"]
+    answers = [counts[word], counts[word], "0", prefix, "".join(prefix.splitlines(True)[:2]), "",
+               "\n".join(csv[:5]) + "\n"]
+
+    port_list = [str(x) for x in range(test_args["base_port"], test_args["base_port"] + 2)]
+    query_port = test_args["base_port"] + 10
+    for run in range(2):
+        # kill any zmq procs currently running
+        util.kill_zmq_distributor_and_worker()
+
+        # first run: count and answer (the index is written), second run: answer from the index alone
+        worker_procs = []
+        args = [test_args["distributor"], "--query", f"tcp://127.0.0.1:{query_port}", "--index", index_file]
+        if run == 0:
+            worker_procs = util.start_threaded_workers(test_args["worker"], port_list)
+            args += [filename] + port_list
+        proc_distributor = util.start_distributor(args, stderr=subprocess.PIPE)
+        util.join_workers(worker_procs)
+
+        reply = query(queries, query_port)
+        assert reply[:-1] == answers, f"run {run + 1} with --query answered wrong."
+        assert reply[-1].startswith("error"), "an unknown query hasn't been answered with an error."
+        assert query(["shutdown"], query_port) == ["ok"], "shutdown query failed."
+
+        distributor_output, distributor_err = proc_distributor.communicate()
+        assert proc_distributor.returncode == 0, f"run {run + 1} with --query failed."
+        if run == 0:
+            assert distributor_output == correct_word_count, "count with --query failed."
+
+
+@pytest.mark.timeout(90)
+def test_reduce_tree(program_args):
+    # with --tree the workers merge the RED tables level by level (COMBINE, or RED_IDS with word IDs) until at most n are
+    # left, the counts have to be the same as without a tree, whatever the MAP results look like
+    # a text of a few words shrinks with every level (several levels), the books hardly do (the tree stops early)
+    filename = test_args["filename_book_1"]
+    few_words = util.get_part_of_word_list(test_args["word_list"], 20)
+    texts = [util.generate_text_from_word_list(few_words, test_args["simple_delimiters"], 1000 * 1000),
+             "\n".join(book.decode("ascii", errors="ignore") for book in test_args["books"])]
+
+    for text in texts:
+        write_text(filename, text)
+        correct_word_count = util.count_words(text)
+        for options in [["--tree", "2"], ["--tree", "8"], ["--tree", "2", "--combine"], ["--tree", "2", "--dictionary"]]:
+            distributor_output, distributor_err, returncode = count_with_options(options, filename, 4)
+            assert returncode == 0, f"distributor with {options} failed."
+            assert distributor_output == correct_word_count, f"count with {options} failed."
+
+
 @pytest.mark.timeout(120)
 def test_memory_leaks(program_args):
     global test_args
@@ -91,6 +91,21 @@ def init_tests(args):
 
     filename_valgrind = "valgrind_test.txt"
 
+    filename_long_words = "long_words_test.txt"
+
+    filename_state = "state_test.txt"
+    filename_state_saved = "state_test.state"
+
+    dirname_chunk_cache = "chunk_cache_test"
+
+    filename_dying_worker = "dying_worker_test.txt"
+
+    dirname_inputs = "input_files_test"
+
+    filename_ranges = "ranges_test.txt"
+
+    filename_index = "index_test.idx"
+
 
     test_args = {"is_ubuntu20_eecs_system": is_ubuntu20_eecs(),
                  "distributor": distributor_exec,
@@ -108,6 +123,14 @@ def init_tests(args):
                  "filename_book_2": filename_book_2,
                  "filename_interop": filename_interop,
                  "filename_valgrind": filename_valgrind,
+                 "filename_long_words": filename_long_words,
+                 "filename_state": filename_state,
+                 "filename_state_saved": filename_state_saved,
+                 "dirname_chunk_cache": dirname_chunk_cache,
+                 "filename_dying_worker": filename_dying_worker,
+                 "dirname_inputs": dirname_inputs,
+                 "filename_ranges": filename_ranges,
+                 "filename_index": filename_index,
                  }
 
     generate_test_files(test_args)
@@ -373,8 +396,8 @@ def start_threaded_workers(worker_exec : Union[str, List[List[str]]], port_list
         return [proc_workers]
 
 
-def start_distributor(dist_args : List[str]):
-    return subprocess.Popen(dist_args, stdout=subprocess.PIPE, encoding="ascii")
+def start_distributor(dist_args : List[str], stderr=None):
+    return subprocess.Popen(dist_args, stdout=subprocess.PIPE, stderr=stderr, encoding="ascii")
 
 
 def run_worker_load_distribution(port, return_dict):
@@ -405,6 +428,15 @@ def run_worker_load_distribution(port, return_dict):
     return_dict[port] = received_requests
 
 
+def run_dying_worker(port):
+    # takes the first task and dies before it answers, like a worker that crashes in the middle of a job
+    context = zmq.Context.instance()
+    socket = context.socket(zmq.REP)
+    socket.bind("tcp://*:" + str(port))
+    socket.recv()
+    socket.close(linger=0)
+
+
 def check_valgrind_output_no_errors(filename):
     if not os.path.isfile(filename):
         return True